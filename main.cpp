@@ -4,12 +4,34 @@
 #include <list>
 #include <initializer_list>
 #include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <string_view>
+#include <charconv>
+#include <zlib.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "cpr/cpr.h"
 #include "gumbo/gumbo.h"
 
 // TODO: Update Dear ImGui to v1.89.2 (https://github.com/ocornut/imgui/commit/bd96f6eac4ad544efb265d7e6bcdb30f99a841c4)
 #include "imgui/imgui.h"
+#include "imgui/imgui_internal.h"
 #include "sokol/sokol_app.h"
 #include "sokol/sokol_gfx.h"
 #include "sokol/sokol_glue.h"
@@ -67,7 +89,99 @@ void AddUnderline(ImColor color = ImGui::GetStyleColorVec4(ImGuiCol_Text)) {
     ImGui::GetWindowDrawList()->AddLine(min, max, color);
 }
 
+// Memory for Gumbo's parse trees, plugged into its allocator hooks. Allocations are taken from large blocks in order,
+// and freeing does nothing. The whole tree is freed at once by `Reset`. Arenas are kept after use and recycled by the
+// next parse, with their blocks.
+class Arena {
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    static constexpr size_t blockSize = 256 << 10;
+    static constexpr size_t maxKept = 8 << 20; // Bytes of blocks kept by a recycled arena.
+    static constexpr size_t maxRecycled = 8;
+    static constexpr size_t alignment = alignof(std::max_align_t);
+
+    std::vector<Block> blocks;
+    size_t block = 0; // The block being filled.
+    size_t used = 0; // Bytes used in that block.
+    std::vector<std::unique_ptr<char[]>> large; // Allocations larger than a block, which aren't kept by `Reset`.
+
+    static inline std::mutex recycledMutex;
+    static inline std::vector<std::unique_ptr<Arena>> recycled;
+
+    void *allocate(size_t size) {
+        size = (size + alignment - 1) & ~(alignment - 1);
+        // Otherwise it would skip the rest of the block being filled, and of the recycled blocks which are too small.
+        if (size > blockSize) {
+            return large.emplace_back(std::make_unique<char[]>(size)).get();
+        }
+        while (block < blocks.size() && used + size > blocks[block].size) {
+            block++;
+            used = 0;
+        }
+        if (block == blocks.size()) {
+            blocks.push_back({std::make_unique<char[]>(blockSize), blockSize});
+            used = 0;
+        }
+        void *pointer = blocks[block].data.get() + used;
+        used += size;
+        return pointer;
+    }
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Frees everything allocated from the arena. Blocks are kept for reuse, up to `maxKept` bytes.
+    void Reset() {
+        size_t kept = 0, count = 0;
+        while (count < blocks.size() && kept + blocks[count].size <= maxKept) {
+            kept += blocks[count++].size;
+        }
+        blocks.resize(count);
+        large.clear();
+        block = 0;
+        used = 0;
+    }
+
+    // Options for `gumbo_parse_with_options` which allocate from this arena.
+    GumboOptions Options() {
+        GumboOptions options = kGumboDefaultOptions;
+        options.allocator = [](void *arena, size_t size) { return ((Arena *)arena)->allocate(size); };
+        options.deallocator = [](void *, void *) {};
+        options.userdata = this;
+        return options;
+    }
+
+    // Returns a recycled arena, or a new one if there is none.
+    static std::unique_ptr<Arena> Take() {
+        {
+            std::lock_guard<std::mutex> lock(recycledMutex);
+            if (!recycled.empty()) {
+                auto arena = std::move(recycled.back());
+                recycled.pop_back();
+                return arena;
+            }
+        }
+        return std::make_unique<Arena>();
+    }
+
+    // Frees everything allocated from the arena and keeps it for the next `Take`.
+    static void Recycle(std::unique_ptr<Arena> arena) {
+        arena->Reset();
+        std::lock_guard<std::mutex> lock(recycledMutex);
+        if (recycled.size() < maxRecycled) {
+            recycled.push_back(std::move(arena));
+        }
+    }
+};
+
 struct HTML {
+    std::unique_ptr<Arena> arena; // Holds the whole tree.
+    GumboOptions options;
     GumboOutput * const output;
     GumboElement *focus;
 
@@ -76,7 +190,8 @@ struct HTML {
     HTML& operator=(const HTML&) = delete;
     HTML& operator=(HTML&&) = delete;
 
-    explicit HTML(char *buffer) : output(gumbo_parse(buffer)), focus(nullptr) {}
+    HTML(const char *buffer, size_t length)
+        : arena(Arena::Take()), options(arena->Options()), output(gumbo_parse_with_options(&options, buffer, length)), focus(nullptr) {}
 
     static bool tagEquals(GumboElement *e, const char *tag) {
         int i = 1;
@@ -120,445 +235,3328 @@ struct HTML {
         return node;
     }
 
+    // The tree isn't walked to free every node, the arena is reset instead.
     ~HTML() {
-        gumbo_destroy_output(&kGumboDefaultOptions, output);
+        Arena::Recycle(std::move(arena));
     }
 };
 
-class WiktionaryProvider {
-    // HTML structure:
-    // (#mw-content-text > .mw-parser-output)
-    //   See also: [.disambig-see-also-2 a]
-    //   Language heading: (h2 > .mw-headline)
-    //   Content
+// Results handed from background threads to the UI thread. Any thread may push without locking, and the UI thread takes
+// everything pushed so far at once, so handling them costs nothing in frames in which nothing completed.
+template <typename T>
+class CompletionQueue {
+    struct Node {
+        T value;
+        Node *next;
+    };
 
-    static GumboElement *findContent(GumboNode *root) {
-        if (root->type != GUMBO_NODE_ELEMENT) return nullptr;
-        GumboNode *node = root;
-        node = HTML::queryNode(node, {"body", "#content", "#bodyContent", "#mw-content-text", ".mw-parser-output"});
-        if (node->type != GUMBO_NODE_ELEMENT || !gumboElementClassEquals(&node->v.element, "mw-parser-output")) return nullptr;
-        return &node->v.element;
+    std::atomic<Node *> head{nullptr}; // The most recently pushed node.
+
+public:
+    CompletionQueue() = default;
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue(CompletionQueue&&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(CompletionQueue&&) = delete;
+
+    void Push(T value) {
+        auto node = new Node{std::move(value), head.load(std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
     }
 
-    static const char *getHeaderText(GumboElement *element) {
-        GumboNode *node;
-        gumboFindChild(node, element->children, (*child)->type == GUMBO_NODE_ELEMENT && gumboElementClassEquals(&(*child)->v.element, "mw-headline"));
-        if (node->type == GUMBO_NODE_ELEMENT && node->v.element.children.length >= 1) {
-            node = (GumboNode *)node->v.element.children.data[0];
-            if (node->type == GUMBO_NODE_TEXT) {
-                return node->v.text.text;
-            }
+    // Calls `handle` with every value pushed since the last call, in the order in which they were pushed. Must only be
+    // called from one thread.
+    template <typename F>
+    void Drain(F &&handle) {
+        Node *node = head.exchange(nullptr, std::memory_order_acquire);
+        Node *oldest = nullptr;
+        while (node != nullptr) {
+            Node *next = node->next;
+            node->next = oldest;
+            oldest = node;
+            node = next;
+        }
+        while (oldest != nullptr) {
+            Node *next = oldest->next;
+            handle(std::move(oldest->value));
+            delete oldest;
+            oldest = next;
         }
-        // Couldn't find the text.
-        return nullptr;
     }
 
-    // If true, then the header is open.
-    bool displayLanguageHeader(GumboNode *node) {
-        assert(node->type == GUMBO_NODE_ELEMENT);
-        const char *text = getHeaderText(&node->v.element);
-        if (text == nullptr) {
-            ImGui::Separator();
-            return true;
-        } else {
-//            return ImGui::CollapsingHeader(text);
-            return ImGui::TreeNodeEx(text, ImGuiTreeNodeFlags_CollapsingHeader | (strncmp(text, defaultLanguage, 256) == 0 ? ImGuiTreeNodeFlags_DefaultOpen : 0));
-        }
+    ~CompletionQueue() {
+        Drain([](T&&) {});
     }
+};
 
-    // Display the node and its children as plain text.
-    static void displayText(GumboNode *node, std::string &text) {
-        if (node->type == GUMBO_NODE_TEXT && node->v.text.text != nullptr) {
-            text += node->v.text.text;
-        } else if (node->type == GUMBO_NODE_WHITESPACE) {
-            text += " ";
-        } else if (node->type == GUMBO_NODE_ELEMENT) {
-            auto &element = node->v.element;
-            gumboForEachChild(element.children) {
-                if ((*child)->type != GUMBO_NODE_ELEMENT) {
-                    displayText(*child, text);
-                    continue;
-                }
-                auto childElement = (*child)->v.element;
-                if (gumboElementClassEquals(&childElement, "audiotable")) continue;
-                switch (childElement.tag) {
-                    // ignore
-                    case GUMBO_TAG_STYLE:
-                        break;
-                    // inline
-                    case GUMBO_TAG_SPAN:
-                    case GUMBO_TAG_I:
-                    case GUMBO_TAG_A:
-                    case GUMBO_TAG_B:
-                    case GUMBO_TAG_EM:
-                    case GUMBO_TAG_U:
-                    case GUMBO_TAG_STRONG:
-                    case GUMBO_TAG_SUB:
-                    case GUMBO_TAG_SUP:
-                    case GUMBO_TAG_ABBR:
-                        displayText(*child, text);
-                        break;
-                    // block
-                    default:
-                        if (!text.empty() && text[text.length() - 1] != '\n') {
-                            text += '\n';
-                        }
-                        displayText(*child, text);
-                        break;
-                }
+// Priority classes of background work, most urgent first.
+enum class Priority : int {
+    Active,      // For the selected tab, or anything else the user is waiting for.
+    Background,  // For the other tabs.
+    Speculative, // Prefetching.
+};
+
+// Returns the current priority of a piece of work. It may change while the work is waiting, e.g. when the user switches
+// tabs. A null function means `Priority::Active`.
+using PriorityFunction = std::function<Priority()>;
+
+static Priority evaluate(const PriorityFunction &priority) {
+    return priority ? priority() : Priority::Active;
+}
+
+// A fixed set of threads executing tasks, one per core. Every thread has its own queue, with a deque for each priority.
+// Tasks pushed from a task go to the queue of its thread, so that the stages of one lookup tend to stay on one core;
+// other tasks are spread over the queues in turn. A thread takes the most urgent class of tasks available: from the
+// back of its own deque, or else from the front of another thread's. Priorities are evaluated when a task is pushed
+// and taken, and for all the queued tasks after `Reprioritized`, so a task is filed under the priority it had then.
+class TaskPool {
+    static constexpr size_t priorities = 3;
+
+    struct Task {
+        std::function<void()> run;
+        PriorityFunction priority;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks[priorities]; // By priority.
+        std::atomic<size_t> sizes[priorities] = {}; // Sizes of `tasks`, so that empty deques are skipped without locking.
+        std::atomic<uint64_t> sorted{0}; // The `generation` for which the tasks were filed.
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex; // Guards sleeping and waking up.
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0}; // Tasks in all the queues.
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<uint64_t> generation{0}; // Incremented by `Reprioritized`.
+    bool stopping = false;
+
+    // The pool and queue of the current thread, if it belongs to a pool.
+    static inline thread_local TaskPool *currentPool = nullptr;
+    static inline thread_local size_t currentQueue = 0;
+
+    static void file(Queue &queue, Task task, Priority priority) {
+        queue.tasks[(int)priority].push_back(std::move(task));
+        queue.sizes[(int)priority]++;
+    }
+
+    // Files the tasks of the queue again under their current priorities, keeping their order. Call with the queue's
+    // mutex locked.
+    void sort(Queue &queue) {
+        uint64_t current = generation;
+        if (queue.sorted == current) return;
+        queue.sorted = current;
+        std::deque<Task> tasks[priorities];
+        for (size_t i = 0; i < priorities; i++) {
+            tasks[i] = std::move(queue.tasks[i]);
+            queue.tasks[i].clear();
+            queue.sizes[i] = 0;
+        }
+        for (auto &deque : tasks) {
+            for (auto &task : deque) {
+                Priority priority = evaluate(task.priority);
+                file(queue, std::move(task), priority);
             }
         }
     }
 
-    static void displayList(GumboElement *element, bool ordered = false) {
-        int counter = 0;
-        gumboForEachChild(element->children) {
-            std::string text;
-            if ((*child)->type == GUMBO_NODE_ELEMENT) {
-                switch ((*child)->v.element.tag) {
-                    case GUMBO_TAG_LI:
-                    case GUMBO_TAG_DD:
-                    case GUMBO_TAG_DT:
-                        if (gumboElementClassEquals(&(*child)->v.element, "mw-empty-elt")) continue;
-                        displayText((*child), text);
-                        if (text.empty()) continue;
-                        counter++;
-                        if (ordered) {
-                            ImGui::Text("%d.", counter);
-                            ImGui::SameLine(0, 0);
-                            ImGui::TextWrapped("%s", text.data());
-                        } else {
-                            ImGui::Bullet();
-                            ImGui::TextWrapped("%s", text.data());
-                        }
-                        break;
-                    default:
-                        displayText((*child), text);
-                        ImGui::TextWrapped("%s", text.data());
-                }
+    // Removes a task of the given priority from the back of the queue if it's the thread's own, or from the front.
+    // A task whose priority has dropped since it was filed is filed again instead.
+    bool take(Queue &queue, Priority priority, bool own, Task &task) {
+        int index = (int)priority;
+        if (queue.sizes[index] == 0 && queue.sorted == generation) return false;
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        sort(queue);
+        auto &tasks = queue.tasks[index];
+        while (!tasks.empty()) {
+            task = own ? std::move(tasks.back()) : std::move(tasks.front());
+            own ? tasks.pop_back() : tasks.pop_front();
+            queue.sizes[index]--;
+            Priority current = evaluate(task.priority);
+            if (current <= priority) {
+                pending--;
+                return true;
             }
+            file(queue, std::move(task), current);
         }
+        return false;
     }
 
-    static void displayDefinition(GumboElement *item) {
-        std::string text;
-        gumboForEachChild(item->children) {
-            if ((*child)->type == GUMBO_NODE_TEXT) {
-                text += (*child)->v.text.text;
-            } else if ((*child)->type == GUMBO_NODE_WHITESPACE) {
-                text += ' ';
-            } else if ((*child)->type == GUMBO_NODE_ELEMENT) {
-                auto &element = (*child)->v.element;
-                switch (element.tag) {
-                    // ignore
-                    case GUMBO_TAG_STYLE:
-                        break;
-                    // special
-                    case GUMBO_TAG_DL:
-                    case GUMBO_TAG_UL: // TODO: If only quotations are in unordered lists, then make them collapsed by default.
-                        for (auto &c : text) {
-                            if (c != ' ' && c != '\n') {
-                                ImGui::TextWrapped("%s", text.data());
-                                text.clear();
-                                break;
-                            }
-                        }
-                        ImGui::Indent(10);
-                        displayList(&element);
-                        ImGui::Unindent(10);
-                        break;
-                    // inline
-                    case GUMBO_TAG_SPAN:
-                    case GUMBO_TAG_I:
-                    case GUMBO_TAG_A:
-                    case GUMBO_TAG_B:
-                    case GUMBO_TAG_EM:
-                    case GUMBO_TAG_U:
-                    case GUMBO_TAG_STRONG:
-                    case GUMBO_TAG_SUB:
-                    case GUMBO_TAG_SUP:
-                    case GUMBO_TAG_ABBR:
-                        displayText(*child, text);
-                        break;
-                    // block
-                    default:
-                        if (!text.empty() && text[text.length() - 1] != '\n') text += '\n';
-                        displayText(*child, text);
-                        break;
-                }
+    bool takeNext(size_t self, Task &task) {
+        for (Priority priority : {Priority::Active, Priority::Background, Priority::Speculative}) {
+            for (size_t i = 0; i < queues.size(); i++) {
+                if (take(*queues[(self + i) % queues.size()], priority, i == 0, task)) return true;
             }
         }
-        if (!text.empty()) {
-            ImGui::TextWrapped("%s", text.data());
-        }
+        return false;
     }
 
-    static void displayDefinitions(GumboElement *list) {
-        int counter = 0;
-        gumboForEachChild(list->children) {
-            std::string text;
-            if ((*child)->type == GUMBO_NODE_ELEMENT) {
-                if ((*child)->v.element.tag == GUMBO_TAG_LI) {
-                    if (gumboElementClassEquals(&(*child)->v.element, "mw-empty-elt")) continue;
-                    displayText((*child), text);
-                    if (text.empty()) continue;
-                    counter++;
-                    ImGui::Text("%d.", counter);
-                    ImGui::SameLine(0, 0);
-                    displayDefinition(&(*child)->v.element);
-                } else {
-                    displayText((*child), text);
-                    ImGui::TextWrapped(".%s", text.data());
-                }
+    void run(size_t self) {
+        currentPool = this;
+        currentQueue = self;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || pending > 0; });
+                if (stopping) return;
+            }
+            Task task;
+            if (takeNext(self, task)) {
+                task.run();
             }
         }
     }
 
-    // Returns the amount of columns occupied by the table cell.
-    static int getTableCellWidth(GumboElement *cell) {
-        auto colspan = gumbo_get_attribute(&cell->attributes, "colspan");
-        if (colspan == nullptr) {
-            return 1;
-        } else {
-            int columns = 1;
-            sscanf(colspan->value, "%d", &columns);
-            return columns;
+public:
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    TaskPool() {
+        size_t count = std::max(std::thread::hardware_concurrency(), 1u);
+        for (size_t i = 0; i < count; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back(&TaskPool::run, this, i);
         }
     }
 
-    // Returns the amount of rows occupied by the table cell.
-    static int getTableCellHeight(GumboElement *cell) {
-        auto rowspan = gumbo_get_attribute(&cell->attributes, "rowspan");
-        if (rowspan == nullptr) {
-            return 1;
-        } else {
-            int columns = 1;
-            sscanf(rowspan->value, "%d", &columns);
-            return columns;
+    // Does nothing once the pool is stopped.
+    void Push(std::function<void()> task, PriorityFunction priority = nullptr) {
+        size_t queue = currentPool == this ? currentQueue : nextQueue++ % queues.size();
+        {
+            // Counted before it's queued, so that `pending` never drops below zero when the task is taken at once.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            pending++;
+        }
+        Priority initial = evaluate(priority);
+        {
+            std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+            file(*queues[queue], {std::move(task), std::move(priority)}, initial);
         }
+        wake.notify_one();
     }
 
-    static void displayTableRow(GumboElement *tr, int columns, std::vector<int> &rowspans) {
-        if (gumboElementClassEquals(tr, "vsShow")) {
-            // These rows are displayed when the table is collapsed.
-            return;
-        }
-        int column = 0, width;
-        ImGui::TableNextRow();
-        gumboForEachChild(tr->children) {
-            if ((*child)->type == GUMBO_NODE_ELEMENT && ((*child)->v.element.tag == GUMBO_TAG_TH || (*child)->v.element.tag == GUMBO_TAG_TD)) {
-                if (column >= columns) goto endRow;
-                while (rowspans[column] > 0) {
-                    rowspans[column]--;
-                    column++;
-                    if (column >= columns) goto endRow;
-                }
-                GumboElement *cell = &(*child)->v.element;
-                std::string text;
-                displayText((*child), text);
-                width = getTableCellWidth(cell);
-                ImGui::TableSetColumnIndex(column);
-                ImGui::PushTextWrapPos(ImGui::GetCursorPosX() + (float)width * ImGui::GetColumnWidth());
-                ImGui::TextWrapped("%s", text.data());
-                ImGui::PopTextWrapPos();
-                for (int i = 0; i < width; i++) {
-                    rowspans[column + i] = getTableCellHeight(cell) - 1;
-                }
-                column += width;
-            }
+    // Call when the priorities of queued tasks may have changed, e.g. when the user switches tabs.
+    void Reprioritized() {
+        generation++;
+    }
+
+    size_t Threads() const {
+        return threads.size();
+    }
+
+    // Waits for the running tasks to finish and drops the queued ones.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
         }
-    endRow:
-        for (int i = column; i < columns; i++) {
-            rowspans[i]--;
+        wake.notify_all();
+        for (auto &thread : threads) {
+            thread.join();
         }
+        threads.clear();
     }
 
-    // Returns the number of columns. If it can't be retrieved, the function returns a negative value.
-    // It may also return 0.
-    static int getTableWidth(GumboElement *tbody) {
-        GumboElement *firstRow;
-        gumboForEachChild(tbody->children) {
-            if ((*child)->type == GUMBO_NODE_ELEMENT && (*child)->v.element.tag == GUMBO_TAG_TR) {
-                firstRow = &(*child)->v.element;
-                break;
-            }
-        }
-        if (firstRow == nullptr) return -1;
-        int columns = 0;
-        gumboForEachChild(firstRow->children) {
-            if ((*child)->type == GUMBO_NODE_ELEMENT && ((*child)->v.element.tag == GUMBO_TAG_TH || (*child)->v.element.tag == GUMBO_TAG_TD)) {
-                columns += getTableCellWidth(&(*child)->v.element);
-            }
+    ~TaskPool() {
+        Stop();
+    }
+};
+
+// Threads performing HTTP requests. Each thread keeps its own `cpr::Session` for its whole lifetime, and all the
+// sessions share the DNS cache, TLS sessions and open connections, so that requests after the first one don't pay
+// for the DNS lookup and TCP and TLS handshakes. HTTP/2 is negotiated when the server supports it.
+// At most `limit` requests run at once. When a session is free, the most urgent waiting request is started. Speculative
+// requests never run two at a time, so that they take at most one session from the requests the user is waiting for.
+class SessionPool {
+public:
+    using Callback = std::function<void(cpr::Response)>;
+    // Returns true if the response is no longer needed.
+    using Cancellation = std::function<bool()>;
+    // Receives the decompressed body in chunks, as they arrive.
+    using Sink = std::function<void(std::string_view)>;
+
+private:
+    struct Request {
+        std::string url;
+        cpr::Header header;
+        Callback then;
+        Cancellation cancelled;
+        Sink sink;
+        PriorityFunction priority;
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> requests;
+    int running = 0;
+    int limit;
+    bool speculating = false;
+    std::atomic<bool> stopping{false}; // Also read by the transfers, which are aborted when it's set.
+    std::vector<std::thread> threads;
+
+    CURLSH *share;
+    std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> reused{0};
+    std::atomic<uint64_t> cancelled{0};
+
+    static void lockShare(CURL *, curl_lock_data data, curl_lock_access, void *pool) {
+        ((SessionPool *)pool)->shareLocks[data].lock();
+    }
+
+    static void unlockShare(CURL *, curl_lock_data data, void *pool) {
+        ((SessionPool *)pool)->shareLocks[data].unlock();
+    }
+
+    void run() {
+        cpr::Session session;
+        session.SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS});
+        session.SetConnectTimeout(cpr::ConnectTimeout{std::chrono::seconds(10)});
+        session.SetTimeout(cpr::Timeout{std::chrono::seconds(60)});
+        // curl decompresses the chunks as they arrive.
+        session.SetAcceptEncoding(cpr::AcceptEncoding{{cpr::AcceptEncodingMethods::gzip, cpr::AcceptEncodingMethods::deflate}});
+        curl_easy_setopt(session.GetCurlHolder()->handle, CURLOPT_SHARE, share);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto next = requests.end();
+            Priority priority;
+            wake.wait(lock, [&] { return stopping || (running < limit && (next = findNext(priority)) != requests.end()); });
+            if (stopping) return;
+            auto request = std::move(*next);
+            requests.erase(next);
+            bool speculative = priority == Priority::Speculative;
+            if (speculative) speculating = true;
+            running++;
+            lock.unlock();
+            perform(session, request);
+            lock.lock();
+            running--;
+            if (speculative) speculating = false;
+            wake.notify_all();
         }
-        return columns;
     }
 
-    static void displayTable(GumboElement *tbody) {
-        ImGui::PushID(tbody);
-        int columns = getTableWidth(tbody);
-        if (columns <= 0) {
-            ImGui::TextUnformatted("(Invalid table)");
-        } else {
-            if (ImGui::BeginTable("Table", columns, ImGuiTableFlags_NoClip|ImGuiTableFlags_BordersOuter|ImGuiTableFlags_RowBg)) {
-                std::vector<int> rowspans(columns, 0); // rowspans[i] = x means to skip the ith column in next x rows.
-                gumboForEachChild(tbody->children) {
-                    if ((*child)->type == GUMBO_NODE_ELEMENT && (*child)->v.element.tag == GUMBO_TAG_TR) {
-                        displayTableRow(&(*child)->v.element, columns, rowspans);
-                    }
-                }
-                ImGui::EndTable();
+    // Returns the most urgent request which may start now, or `requests.end()`.
+    std::deque<Request>::iterator findNext(Priority &nextPriority) {
+        auto next = requests.end();
+        for (auto it = requests.begin(); it != requests.end(); it++) {
+            Priority priority = evaluate(it->priority);
+            if (next == requests.end() || priority < nextPriority) {
+                next = it;
+                nextPriority = priority;
+                if (priority == Priority::Active) break;
             }
         }
-        ImGui::PopID();
+        if (next != requests.end() && nextPriority == Priority::Speculative && speculating) return requests.end();
+        return next;
     }
 
-    static void displayRecursive(GumboNode *node) {
-        if (node->type == GUMBO_NODE_TEXT && node->v.text.text != nullptr) {
-            ImGui::TextUnformatted(node->v.text.text);
-        } else if (node->type == GUMBO_NODE_ELEMENT) {
-            auto &element = node->v.element;
-            std::string text;
-            // TODO: div.list-switcher (multi-column ul)
-            switch (element.tag) {
-                case GUMBO_TAG_STYLE:
-                case GUMBO_TAG_DIV: // TODO: Should there be any exceptions to this?
-                    break;
-                case GUMBO_TAG_H3:
-                    ImGui::Dummy(ImVec2(0.0f, 0.5f * ImGui::GetTextLineHeightWithSpacing()));
-                    ImGui::Separator();
-                    ImGui::TextUnformatted(safeCharPtr(getHeaderText(&element)));
-                    AddUnderline();
-                    break;
-                case GUMBO_TAG_H4:
-                case GUMBO_TAG_H5:
-                case GUMBO_TAG_H6:
-                    ImGui::Dummy(ImVec2(0.0f, 0.5f * ImGui::GetTextLineHeightWithSpacing()));
-                    ImGui::TextUnformatted(safeCharPtr(getHeaderText(&element)));
-                    AddUnderline();
-                    break;
-                case GUMBO_TAG_P:
-                    displayText(node, text);
-                    ImGui::TextWrapped("%s", text.data());
-                    break;
-                case GUMBO_TAG_UL:
-                    displayList(&element);
-                    break;
-                case GUMBO_TAG_OL: // I hope that ordered lists always contain definitions...
-                    displayDefinitions(&element);
-                    break;
-                case GUMBO_TAG_HR:
-                    break;
-                case GUMBO_TAG_TBODY:
-                    displayTable(&element);
-                    break;
-                default:
-                    gumboForEachChild(element.children) {
-                        displayRecursive(*child);
-                    }
-                    break;
+    void perform(cpr::Session &session, Request &request) {
+        if (stopping || request.cancelled()) {
+            cancelled++;
+            return;
+        }
+        session.SetUrl(cpr::Url{request.url});
+        session.SetHeader(request.header);
+        // Aborts the transfer as soon as the response is no longer needed, freeing the session for other requests.
+        session.SetProgressCallback(cpr::ProgressCallback{[this, &request](cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, cpr::cpr_off_t, intptr_t) {
+            return !stopping && !request.cancelled();
+        }});
+        std::string body;
+        session.SetWriteCallback(cpr::WriteCallback{[&request, &body](std::string_view data, intptr_t) {
+            if (request.sink) {
+                request.sink(data);
+            } else {
+                body.append(data);
             }
+            return true;
+        }});
+        auto response = session.Get();
+        response.text = std::move(body);
+        // A response which was complete before it was cancelled is still handed over, e.g. to be cached.
+        if (stopping || (response.error && request.cancelled())) {
+            cancelled++;
+            return;
         }
+        long connects = 0;
+        if (curl_easy_getinfo(session.GetCurlHolder()->handle, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK && connects == 0 && !response.error) {
+            reused++;
+        }
+        completed++;
+        request.then(std::move(response));
     }
 
-    class Query {
-    private:
-        char query[256] = "";
-        bool done = false;
-        cpr::AsyncResponse request;
-        std::string rawData;
-        HTML *data = nullptr;
+public:
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    static constexpr int maxLimit = 16;
 
-        void processResult() {
-            data = new HTML(rawData.data());
-            data->focus = findContent(data->output->root);
+    explicit SessionPool(int limit = 4) : limit(limit), share(curl_share_init()) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+        for (int i = 0; i < maxLimit; i++) {
+            threads.emplace_back(&SessionPool::run, this);
         }
+    }
 
-        void getQueryURL(char *out) const {
-            sprintf(out, "https://en.wiktionary.org/wiki/%s", query);
+    // Aborts the running transfers, drops the waiting requests and waits for the threads to exit. Requests made
+    // afterwards are dropped.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            requests.clear();
+        }
+        wake.notify_all();
+        for (auto &thread : threads) {
+            thread.join();
         }
+        threads.clear();
+    }
 
-    public:
-        // Returns false when the tab gets closed.
-        bool DisplayAsTabItem(WiktionaryProvider &provider) {
-            bool open = true;
-            if (ImGui::BeginTabItem(query, &open)) {
-                // TODO: Handle the case when there are multiple equal queries.
-                // TODO: Alternative search results dropdown
-                if (!done) {
-                    if (request.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-                        auto r = request.get();
-                        rawData = r.text;
-                        done = true;
-                        processResult();
-                    } else {
-                        displayLoadingIcon();
-                    }
-                } else {
-                    assert(data != nullptr);
-                    auto content = data->focus;
-                    if (content != nullptr) {
-                        bool show = true;
-                        bool firstHeading = true;
-                        gumboForEachChild(content->children) {
-                            if ((*child)->type == GUMBO_NODE_ELEMENT && (*child)->v.element.tag == GUMBO_TAG_H2) {
-                                show = provider.displayLanguageHeader(*child);
-                                firstHeading = true;
-                            } else if (show) {
-                                if (firstHeading && (*child)->type == GUMBO_NODE_ELEMENT && (*child)->v.element.tag == GUMBO_TAG_H3) {
-                                    ImGui::TextUnformatted(safeCharPtr(getHeaderText(&(*child)->v.element)));
-                                    AddUnderline();
-                                    firstHeading = false;
-                                } else {
-                                    displayRecursive(*child);
-                                }
-                            }
-                        }
-                    } else {
-                        ImGui::TextUnformatted("Could not retrieve content.");
-                    }
-                }
-                ImGui::EndTabItem();
-            }
-            return open;
+    ~SessionPool() {
+        Stop();
+        curl_share_cleanup(share);
+    }
+
+    // Performs a GET request and calls `then` with the response, on one of the pool's threads. If `cancelled` returns
+    // true before the request is started or while it's in progress, the transfer is aborted and `then` is not called.
+    // A transfer which completed is passed to `then` even if it has been cancelled since.
+    // If there's a `sink`, the body is passed to it instead of `cpr::Response::text`.
+    void Get(std::string url, cpr::Header header, Callback then, Cancellation cancelled, Sink sink = nullptr, PriorityFunction priority = nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            requests.push_back({std::move(url), std::move(header), std::move(then), std::move(cancelled), std::move(sink), std::move(priority)});
         }
+        wake.notify_one();
+    }
 
-        explicit Query(char *text) {
+    // Sets the maximum number of requests running at once, between 1 and `maxLimit`.
+    void SetLimit(int requests) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            limit = std::clamp(requests, 1, maxLimit);
+        }
+        wake.notify_all();
+    }
+
+    // Call when the priority of waiting requests changed.
+    void Reprioritized() {
+        wake.notify_all();
+    }
+
+    uint64_t Completed() const { return completed; }
+
+    // Number of completed requests which didn't have to open a new connection.
+    uint64_t Reused() const { return reused; }
+
+    uint64_t Cancelled() const { return cancelled; }
+};
+
+// Persistent cache of response bodies, stored compressed in a directory with one file per page. Entries are evicted
+// by the Greedy-Dual-Size-Frequency policy when the total size exceeds the budget: the priority of an entry is the
+// number of times it was used divided by its size, plus the priority of the last evicted entry, so that entries
+// which haven't been used for a long time eventually go even if they were popular. Thread-safe.
+class ResponseCache {
+public:
+    struct Entry {
+        std::string body;
+        std::string etag;
+        std::string lastModified;
+        bool fresh = false; // False if the entry should be revalidated.
+    };
+
+    // Entries older than this are revalidated.
+    static constexpr int64_t maxAge = 24 * 60 * 60;
+
+    // Compresses a body for `Store` incrementally, so that it can be done while the body is being downloaded, without
+    // holding the whole body and its compressed copy at once.
+    class Compressor {
+        friend class ResponseCache;
+        z_stream stream{};
+        std::string output;
+        bool ok;
+
+        void deflateChunk(std::string_view data, int flush) {
+            if (!ok) return;
+            stream.next_in = (Bytef *)data.data();
+            stream.avail_in = (uInt)data.size();
+            while (true) {
+                if (output.size() - stream.total_out < 4096) {
+                    output.resize(std::max<size_t>(output.size() * 2, 16384));
+                }
+                stream.next_out = (Bytef *)output.data() + stream.total_out;
+                stream.avail_out = (uInt)(output.size() - stream.total_out);
+                int result = deflate(&stream, flush);
+                if (result == Z_STREAM_END) return;
+                if (result != Z_OK && result != Z_BUF_ERROR) {
+                    ok = false;
+                    return;
+                }
+                if (flush == Z_NO_FLUSH && stream.avail_in == 0) return;
+            }
+        }
+
+    public:
+        Compressor(const Compressor&) = delete;
+        Compressor& operator=(const Compressor&) = delete;
+
+        Compressor() {
+            ok = deflateInit(&stream, Z_BEST_SPEED) == Z_OK;
+        }
+
+        ~Compressor() {
+            deflateEnd(&stream);
+        }
+
+        void Append(std::string_view data) {
+            deflateChunk(data, Z_NO_FLUSH);
+        }
+
+        void Finish() {
+            deflateChunk({}, Z_FINISH);
+        }
+    };
+
+private:
+    struct Info {
+        uint64_t size = 0; // Size of the file.
+        uint32_t frequency = 0;
+        int64_t fetched = 0; // Unix time of the last (re)validation.
+        double priority = 0;
+        std::string etag;
+        std::string lastModified;
+    };
+
+    // Bodies are never this large, a larger size in the header of a file means that it's corrupt.
+    static constexpr uint64_t maxBody = 64 << 20;
+    // The index is saved at most this often, in seconds, and when the cache is destroyed.
+    static constexpr int64_t saveInterval = 30;
+
+    // Guards the index. Files are read and written without holding it: new files are written under a temporary name and
+    // renamed, so that a file is never seen partially written.
+    std::mutex mutex;
+    std::string directory; // Empty if caching is disabled. Never changes after construction.
+    std::unordered_map<std::string, Info> index;
+    uint64_t used = 0;
+    uint64_t budget = 64 << 20;
+    double inflation = 0; // Priority of the last evicted entry.
+    bool dirty = false; // True if the index changed since it was saved.
+    int64_t saved = 0; // Unix time of the last save.
+    std::mutex saving; // Held while the index is being written.
+    std::atomic<uint64_t> temporaries{0}; // For unique names of temporary files.
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // The file name is a hash of the title, since titles may contain characters not allowed in file names.
+    std::string path(const std::string &title) const {
+        uint64_t hash = 14695981039346656037ull; // FNV-1a
+        for (unsigned char c : title) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+        return directory + "/" + name;
+    }
+
+    void touch(Info &info) {
+        info.frequency++;
+        info.priority = inflation + (double)info.frequency / (double)std::max<uint64_t>(info.size, 1);
+    }
+
+    // Index format: one line per entry, fields separated by tabs: title, size, frequency, fetched, ETag, Last-Modified.
+    void loadIndex() {
+        std::ifstream file(directory + "/index");
+        std::string line;
+        while (std::getline(file, line)) {
+            std::vector<std::string> fields;
+            size_t start = 0, tab;
+            while ((tab = line.find('\t', start)) != std::string::npos) {
+                fields.push_back(line.substr(start, tab - start));
+                start = tab + 1;
+            }
+            fields.push_back(line.substr(start));
+            if (fields.size() != 6) continue;
+            Info info;
+            info.size = strtoull(fields[1].c_str(), nullptr, 10);
+            info.frequency = (uint32_t)strtoul(fields[2].c_str(), nullptr, 10);
+            info.fetched = strtoll(fields[3].c_str(), nullptr, 10);
+            info.priority = (double)info.frequency / (double)std::max<uint64_t>(info.size, 1);
+            info.etag = fields[4];
+            info.lastModified = fields[5];
+            used += info.size;
+            index[fields[0]] = std::move(info);
+        }
+    }
+
+    // Saves the index if it changed, unless it was saved less than `saveInterval` seconds ago and `force` isn't set.
+    // Only copying the index is done under the lock.
+    void saveIndex(bool force) {
+        std::unique_lock<std::mutex> save(saving, std::defer_lock);
+        if (force) {
+            save.lock();
+        } else if (!save.try_lock()) {
+            return; // Another thread is saving it right now.
+        }
+        std::string contents;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!dirty || (!force && now() - saved < saveInterval)) return;
+            for (auto &[title, info] : index) {
+                contents += title + '\t' + std::to_string(info.size) + '\t' + std::to_string(info.frequency) + '\t'
+                            + std::to_string(info.fetched) + '\t' + info.etag + '\t' + info.lastModified + '\n';
+            }
+            dirty = false;
+            saved = now();
+        }
+        std::string temporary = directory + "/index.tmp";
+        std::error_code error;
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            file.write(contents.data(), (std::streamsize)contents.size());
+            if (!file) error = std::make_error_code(std::errc::io_error);
+        }
+        if (!error) std::filesystem::rename(temporary, directory + "/index", error);
+        if (error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            dirty = true;
+        }
+    }
+
+    // Removes the entries with the lowest priorities from the index until it fits in the budget. Call with the lock
+    // held, and remove the files added to `evicted` after releasing it.
+    void evict(std::vector<std::string> &evicted) {
+        while (used > budget && !index.empty()) {
+            auto victim = index.begin();
+            for (auto it = index.begin(); it != index.end(); it++) {
+                if (it->second.priority < victim->second.priority) victim = it;
+            }
+            inflation = victim->second.priority;
+            used -= victim->second.size;
+            evicted.push_back(path(victim->first));
+            index.erase(victim);
+            dirty = true;
+        }
+    }
+
+    static void removeFiles(const std::vector<std::string> &files) {
+        for (auto &file : files) {
+            std::error_code error;
+            std::filesystem::remove(file, error);
+        }
+    }
+
+    // Reads and inflates the body stored for the title. Fails if the file is corrupt.
+    bool read(const std::string &title, std::string &body) const {
+        // File format: title, newline, uncompressed size, newline, zlib stream.
+        std::string name = path(title);
+        std::error_code error;
+        uintmax_t fileSize = std::filesystem::file_size(name, error);
+        if (error || fileSize > maxBody) return false;
+        std::ifstream file(name, std::ios::binary);
+        std::string storedTitle;
+        uint64_t size = 0;
+        if (!std::getline(file, storedTitle) || storedTitle != title || !(file >> size) || file.get() != '\n' || size > maxBody) {
+            return false;
+        }
+        std::string compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        body.resize(size);
+        uLongf length = (uLongf)size;
+        if (uncompress((Bytef *)body.data(), &length, (const Bytef *)compressed.data(), compressed.size()) != Z_OK) {
+            return false;
+        }
+        body.resize(length);
+        return true;
+    }
+
+public:
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    ResponseCache() {
+        const char *base = getenv("XDG_CACHE_HOME");
+        const char *home = getenv("HOME");
+        if (base != nullptr && base[0] != '\0') {
+            directory = std::string(base) + "/stol";
+        } else if (home != nullptr && home[0] != '\0') {
+            directory = std::string(home) + "/.cache/stol";
+        } else {
+            return;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            directory.clear();
+            return;
+        }
+        loadIndex();
+    }
+
+    ~ResponseCache() {
+        if (!directory.empty()) saveIndex(true);
+    }
+
+    void SetBudget(uint64_t bytes) {
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            budget = bytes;
+            if (directory.empty()) return;
+            evict(evicted);
+        }
+        removeFiles(evicted);
+    }
+
+    // Returns false if there's no entry for the title.
+    bool Load(const std::string &title, Entry &out) {
+        Info info;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (directory.empty()) return false;
+            auto it = index.find(title);
+            if (it == index.end()) return false;
+            touch(it->second);
+            dirty = true;
+            info = it->second;
+        }
+        if (!read(title, out.body)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(title);
+            // Unless the entry has been stored again in the meantime.
+            if (it != index.end() && it->second.fetched == info.fetched) {
+                used -= it->second.size;
+                index.erase(it);
+                dirty = true;
+            }
+            return false;
+        }
+        out.etag = info.etag;
+        out.lastModified = info.lastModified;
+        out.fresh = now() - info.fetched < maxAge;
+        saveIndex(false);
+        return true;
+    }
+
+    // Stores the body compressed by `compressor`, which must be finished.
+    void Store(const std::string &title, const Compressor &compressor, const std::string &etag, const std::string &lastModified) {
+        if (!compressor.ok || directory.empty()) return;
+        std::string header = title + '\n' + std::to_string(compressor.stream.total_in) + '\n';
+        std::string name = path(title);
+        std::string temporary = name + ".tmp" + std::to_string(temporaries++);
+        std::error_code error;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(header.data(), (std::streamsize)header.size());
+            file.write(compressor.output.data(), (std::streamsize)compressor.stream.total_out);
+            if (!file) error = std::make_error_code(std::errc::io_error);
+        }
+        if (!error) std::filesystem::rename(temporary, name, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &info = index[title];
+            used -= info.size;
+            info.size = header.size() + compressor.stream.total_out;
+            used += info.size;
+            info.fetched = now();
+            info.etag = etag;
+            info.lastModified = lastModified;
+            touch(info);
+            evict(evicted);
+            dirty = true;
+        }
+        removeFiles(evicted);
+        saveIndex(false);
+    }
+
+    void Store(const std::string &title, std::string_view body, const std::string &etag, const std::string &lastModified) {
+        Compressor compressor;
+        compressor.Append(body);
+        compressor.Finish();
+        Store(title, compressor, etag, lastModified);
+    }
+
+    // Marks the entry as fresh, after the server confirmed that it's up to date.
+    void Revalidated(const std::string &title) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(title);
+        if (it != index.end()) {
+            it->second.fetched = now();
+            dirty = true;
+        }
+    }
+};
+
+// Appends the code point to `out`, encoded in UTF-8.
+static void appendUTF8(std::string &out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out += (char)codepoint;
+    } else if (codepoint < 0x800) {
+        out += (char)(0xC0 | (codepoint >> 6));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        out += (char)(0xE0 | (codepoint >> 12));
+        out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    } else {
+        out += (char)(0xF0 | (codepoint >> 18));
+        out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+        out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out += (char)(0x80 | (codepoint & 0x3F));
+    }
+}
+
+// Minimal JSON reader, enough for MediaWiki API responses. Parsing never fails loudly: malformed input yields a null
+// value (or a partially filled one), and accessing missing members yields a null value.
+struct JSON {
+    enum Type { Null, Boolean, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JSON> array;
+    std::vector<std::pair<std::string, JSON>> object;
+
+    const JSON &operator[](const char *key) const {
+        for (auto &member : object) {
+            if (member.first == key) return member.second;
+        }
+        return null();
+    }
+
+    const JSON &operator[](size_t index) const {
+        return index < array.size() ? array[index] : null();
+    }
+
+    static JSON Parse(std::string_view text) {
+        JSON value;
+        const char *c = text.data();
+        parseValue(c, text.data() + text.size(), value);
+        return value;
+    }
+
+private:
+    static const JSON &null() {
+        static const JSON value;
+        return value;
+    }
+
+    static void skipSpace(const char *&c, const char *end) {
+        while (c < end && std::isspace((unsigned char)*c)) c++;
+    }
+
+    static uint32_t parseHex(const char *&c, const char *end) {
+        uint32_t value = 0;
+        for (int i = 0; i < 4 && c < end; i++, c++) {
+            value <<= 4;
+            if (*c >= '0' && *c <= '9') value |= *c - '0';
+            else if (*c >= 'a' && *c <= 'f') value |= *c - 'a' + 10;
+            else if (*c >= 'A' && *c <= 'F') value |= *c - 'A' + 10;
+        }
+        return value;
+    }
+
+    // `c` points after the opening quote.
+    static bool parseString(const char *&c, const char *end, std::string &out) {
+        while (c < end && *c != '"') {
+            const char *run = c;
+            while (c < end && *c != '"' && *c != '\\') c++;
+            out.append(run, c);
+            if (c >= end || *c == '"') break;
+            if (++c >= end) return false;
+            switch (*c++) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t codepoint = parseHex(c, end);
+                    if (codepoint >= 0xD800 && codepoint < 0xDC00 && end - c >= 6 && c[0] == '\\' && c[1] == 'u') {
+                        c += 2;
+                        uint32_t low = parseHex(c, end);
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUTF8(out, codepoint);
+                    break;
+                }
+                default: out += c[-1]; break;
+            }
+        }
+        if (c >= end) return false;
+        c++;
+        return true;
+    }
+
+    static bool parseValue(const char *&c, const char *end, JSON &out) {
+        skipSpace(c, end);
+        if (c >= end) return false;
+        switch (*c) {
+            case '{':
+                out.type = Object;
+                c++;
+                skipSpace(c, end);
+                if (c < end && *c == '}') return ++c, true;
+                while (c < end) {
+                    skipSpace(c, end);
+                    if (c >= end || *c != '"') return false;
+                    c++;
+                    out.object.emplace_back();
+                    if (!parseString(c, end, out.object.back().first)) return false;
+                    skipSpace(c, end);
+                    if (c >= end || *c != ':') return false;
+                    c++;
+                    if (!parseValue(c, end, out.object.back().second)) return false;
+                    skipSpace(c, end);
+                    if (c < end && *c == ',') { c++; continue; }
+                    if (c < end && *c == '}') return ++c, true;
+                    return false;
+                }
+                return false;
+            case '[':
+                out.type = Array;
+                c++;
+                skipSpace(c, end);
+                if (c < end && *c == ']') return ++c, true;
+                while (c < end) {
+                    out.array.emplace_back();
+                    if (!parseValue(c, end, out.array.back())) return false;
+                    skipSpace(c, end);
+                    if (c < end && *c == ',') { c++; continue; }
+                    if (c < end && *c == ']') return ++c, true;
+                    return false;
+                }
+                return false;
+            case '"':
+                out.type = String;
+                c++;
+                return parseString(c, end, out.string);
+            case 't':
+            case 'f':
+                out.type = Boolean;
+                out.boolean = *c == 't';
+                while (c < end && std::isalpha((unsigned char)*c)) c++;
+                return true;
+            case 'n':
+                while (c < end && std::isalpha((unsigned char)*c)) c++;
+                return true;
+            default: {
+                out.type = Number;
+                out.number = strtod(std::string(c, std::min<size_t>(end - c, 64)).c_str(), nullptr);
+                while (c < end && (std::isdigit((unsigned char)*c) || *c == '-' || *c == '+' || *c == '.' || *c == 'e' || *c == 'E')) c++;
+                return true;
+            }
+        }
+    }
+};
+
+// A single step of a precompiled page. The DOM is lowered into a flat list of these once, after the page is parsed,
+// and each frame only replays the list (see `WiktionaryProvider::displayCommands`).
+struct DisplayCommand {
+    enum Kind : unsigned char {
+        LanguageHeading, // Collapsing header with the language name, see `Page::AddLanguageHeading`.
+        Separator,
+        Heading,         // h3: spacing, separator and underlined text.
+        Subheading,      // h4-h6: spacing and underlined text.
+        FirstHeading,    // The first h3 after a language heading: underlined text.
+        Text,            // Unformatted, unwrapped text.
+        WrappedText,
+        Bullet,          // Followed by the item's text on the same line.
+        Number,          // "`value`." followed by the item's content on the same line.
+        Indent,          // Indents by `value` pixels.
+        Unindent,        // Unindents by `value` pixels.
+        TableBegin,      // `value` columns and `span` rows. `next` is the index of the command after the matching `TableEnd`.
+        TableRow,        // Followed by a `TableCell` for each column.
+        TableCell,       // Text in column `value`, spanning `span` columns. Empty if `span` is 0.
+        TableEnd,
+    } kind;
+    int value = 0;
+    int span = 0;
+    int next = 0;
+    int text = 0, length = 0; // The command's text in the page's pool, see `Page::TextOf`.
+
+    explicit DisplayCommand(Kind kind, int value = 0) : kind(kind), value(value) {}
+};
+
+// Substring search over raw response bodies, for the few markers which are looked for without parsing. Candidate
+// positions are found by comparing the first and the last byte of the marker with 16 (SSE2) or 32 (AVX2) positions at
+// once, and only those are compared in full. AVX2 is used if the CPU supports it, and the standard library elsewhere.
+class ByteScanner {
+    using Search = size_t (*)(const char *data, size_t size, std::string_view marker, size_t from);
+
+    static size_t findScalar(const char *data, size_t size, std::string_view marker, size_t from) {
+        return std::string_view(data, size).find(marker, from);
+    }
+
+#if defined(__SSE2__)
+    static size_t findSSE2(const char *data, size_t size, std::string_view marker, size_t from) {
+        const __m128i first = _mm_set1_epi8(marker.front());
+        const __m128i last = _mm_set1_epi8(marker.back());
+        size_t i = from;
+        for (; i + marker.size() - 1 + 16 <= size; i += 16) {
+            __m128i firstBlock = _mm_loadu_si128((const __m128i *)(data + i));
+            __m128i lastBlock = _mm_loadu_si128((const __m128i *)(data + i + marker.size() - 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, firstBlock), _mm_cmpeq_epi8(last, lastBlock)));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t candidate = i + __builtin_ctz(mask);
+                if (memcmp(data + candidate + 1, marker.data() + 1, marker.size() - 2) == 0) return candidate;
+            }
+        }
+        return findScalar(data, size, marker, i);
+    }
+#endif
+
+#if defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+    __attribute__((target("avx2")))
+    static size_t findAVX2(const char *data, size_t size, std::string_view marker, size_t from) {
+        const __m256i first = _mm256_set1_epi8(marker.front());
+        const __m256i last = _mm256_set1_epi8(marker.back());
+        size_t i = from;
+        for (; i + marker.size() - 1 + 32 <= size; i += 32) {
+            __m256i firstBlock = _mm256_loadu_si256((const __m256i *)(data + i));
+            __m256i lastBlock = _mm256_loadu_si256((const __m256i *)(data + i + marker.size() - 1));
+            unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, firstBlock), _mm256_cmpeq_epi8(last, lastBlock)));
+            for (; mask != 0; mask &= mask - 1) {
+                size_t candidate = i + __builtin_ctz(mask);
+                if (memcmp(data + candidate + 1, marker.data() + 1, marker.size() - 2) == 0) return candidate;
+            }
+        }
+        return findSSE2(data, size, marker, i);
+    }
+#endif
+
+    static Search select() {
+#if defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+        if (__builtin_cpu_supports("avx2")) return findAVX2;
+#endif
+#if defined(__SSE2__)
+        return findSSE2;
+#else
+        return findScalar;
+#endif
+    }
+
+    static inline const Search search = select();
+
+public:
+    // Returns the position of the first occurrence of `marker` in `html` at or after `from`, or `npos`.
+    static size_t Find(std::string_view html, std::string_view marker, size_t from = 0) {
+        if (marker.size() < 2) return html.find(marker, from);
+        if (from >= html.size()) return std::string_view::npos;
+        return search(html.data(), html.size(), marker, from);
+    }
+
+    // Returns the name of the implementation in use.
+    static const char *Implementation() {
+#if defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+        if (search == findAVX2) return "AVX2";
+#endif
+#if defined(__SSE2__)
+        if (search == findSSE2) return "SSE2";
+#endif
+        return "scalar";
+    }
+};
+
+// Finds the language sections of a page in its raw HTML while it's being downloaded, without parsing it. A section
+// starts with an `<h2` tag and ends where the next one starts. Other `h2` elements, like the table of contents heading,
+// are found too, but they have no anchor.
+class SectionScanner {
+    size_t scanned = 0;
+
+public:
+    std::vector<size_t> headings; // Positions of the `<h2` tags.
+
+    // Scans the part of `html` which was appended since the last call.
+    void Scan(std::string_view html) {
+        // A tag split between two chunks is found in the second scan.
+        size_t position = scanned >= 2 ? scanned - 2 : 0;
+        while ((position = ByteScanner::Find(html, "<h2", position)) != std::string_view::npos) {
+            headings.push_back(position);
+            position += 3;
+        }
+        scanned = html.size();
+    }
+
+    // Returns the anchor of the heading starting at `position` (the id of its `.mw-headline`, which is the language
+    // name with underscores instead of spaces), or an empty string if it has none or isn't complete yet.
+    static std::string_view HeadingAnchor(std::string_view html, size_t position) {
+        size_t end = ByteScanner::Find(html, "</h2>", position);
+        if (end == std::string_view::npos) return {};
+        size_t headline = ByteScanner::Find(html, "mw-headline", position);
+        if (headline >= end) return {};
+        size_t id = ByteScanner::Find(html, "id=\"", headline);
+        if (id >= end) return {};
+        id += 4;
+        size_t idEnd = html.find('"', id);
+        if (idEnd >= end) return {};
+        return html.substr(id, idEnd - id);
+    }
+
+    // Returns the position of the opening tag of `.mw-parser-output`, or `npos` if it isn't there.
+    static size_t ContentStart(std::string_view html) {
+        size_t marker = ByteScanner::Find(html, "class=\"mw-parser-output\"");
+        if (marker == std::string_view::npos) return marker;
+        return html.rfind('<', marker);
+    }
+
+    // Returns the text of the heading's `.mw-headline`, as `HeadingAnchor` finds it, or an empty string.
+    static std::string_view HeadingText(std::string_view html, size_t position) {
+        size_t end = ByteScanner::Find(html, "</h2>", position);
+        if (end == std::string_view::npos) return {};
+        size_t headline = ByteScanner::Find(html, "mw-headline", position);
+        if (headline >= end) return {};
+        size_t begin = html.find('>', headline);
+        if (begin >= end) return {};
+        begin++;
+        size_t textEnd = html.find('<', begin);
+        if (textEnd > end) return {};
+        return html.substr(begin, textEnd - begin);
+    }
+};
+
+// The part of a page's HTML which is lowered into display commands: `.mw-parser-output` and its descendants. Nodes are
+// stored as parallel arrays indexed by node, and refer to each other by index. Of the attributes, only the classes
+// which the lowering looks for (as flags), links, the ids of spans and table spans are kept. All the text is in one pool, so the
+// document doesn't depend on the HTML it was parsed from, or on Gumbo's tree.
+struct Markup {
+    enum Type : uint8_t {
+        Element,
+        Text,
+        Whitespace, // Text consisting only of whitespace. Its text isn't kept.
+    };
+
+    // Values of the `class` attribute which the lowering looks for. Other values are dropped.
+    enum Class : uint8_t {
+        ParserOutput = 1 << 0, // mw-parser-output
+        Headline = 1 << 1,     // mw-headline
+        EmptyElement = 1 << 2, // mw-empty-elt
+        AudioTable = 1 << 3,   // audiotable
+        CollapsedRow = 1 << 4, // vsShow
+    };
+
+    struct Span {
+        uint32_t offset = 0, length = 0;
+    };
+
+    // A node being added.
+    struct Node {
+        Type type = Element;
+        GumboTag tag = GUMBO_TAG_UNKNOWN;
+        uint8_t classes = 0;
+        Span text; // Of text nodes, the `href` of links, or the `id` of spans.
+        uint16_t colspan = 1, rowspan = 1;
+    };
+
+    std::vector<Type> types;
+    std::vector<uint8_t> tags;
+    std::vector<uint8_t> classes;
+    std::vector<int> firstChildren, nextSiblings; // -1 if there is none.
+    std::vector<Span> texts;
+    std::vector<uint16_t> colspans, rowspans;
+    std::string pool;
+
+    // The first node is `.mw-parser-output`. There are none if the content wasn't found.
+    bool Empty() const {
+        return types.empty();
+    }
+
+    bool IsElement(int node, GumboTag tag) const {
+        return types[node] == Element && tags[node] == tag;
+    }
+
+    bool HasClass(int node, Class cl) const {
+        return (classes[node] & cl) != 0;
+    }
+
+    std::string_view TextOf(int node) const {
+        return std::string_view(pool).substr(texts[node].offset, texts[node].length);
+    }
+
+    std::string_view HrefOf(int node) const {
+        return TextOf(node);
+    }
+
+    std::string_view IdOf(int node) const {
+        return TextOf(node);
+    }
+
+    // Appends a node as the next sibling of `previous` or, if there is none, as the first child of `parent`.
+    int Append(const Node &node, int parent, int previous) {
+        int index = (int)types.size();
+        types.push_back(node.type);
+        tags.push_back(node.tag < 256 ? (uint8_t)node.tag : (uint8_t)GUMBO_TAG_UNKNOWN);
+        classes.push_back(node.classes);
+        firstChildren.push_back(-1);
+        nextSiblings.push_back(-1);
+        texts.push_back(node.text);
+        colspans.push_back(node.colspan);
+        rowspans.push_back(node.rowspan);
+        if (previous >= 0) {
+            nextSiblings[previous] = index;
+        } else if (parent >= 0) {
+            firstChildren[parent] = index;
+        }
+        return index;
+    }
+
+    // Copies the text to the pool.
+    Span Store(std::string_view text) {
+        Span span{(uint32_t)pool.size(), (uint32_t)text.size()};
+        pool.append(text);
+        return span;
+    }
+
+    static uint8_t ClassOf(std::string_view value) {
+        if (value == "mw-parser-output") return ParserOutput;
+        if (value == "mw-headline") return Headline;
+        if (value == "mw-empty-elt") return EmptyElement;
+        if (value == "audiotable") return AudioTable;
+        if (value == "vsShow") return CollapsedRow;
+        return 0;
+    }
+
+    static bool IsWhitespace(std::string_view text) {
+        return std::all_of(text.begin(), text.end(), [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; });
+    }
+
+    static uint16_t ParseSpan(std::string_view value) {
+        int span = 1;
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        std::from_chars(value.data(), value.data() + value.size(), span);
+        return (uint16_t)std::clamp(span, 0, 1000);
+    }
+};
+
+// A for loop iterating over the children of the node `parent` of `markup`. Exposes the variable `child`, the index of
+// the child.
+#define markupForEachChild(markup, parent) for (int child = (markup).firstChildren[parent]; child >= 0; child = (markup).nextSiblings[child])
+
+// Builds the `Markup` of a page from HTML as MediaWiki emits it, which is serialized from a parsed tree: every element
+// which isn't void is closed explicitly and in order, tables have a `tbody`, attribute values are quoted, and `&` and
+// `<` are always escaped. This takes a fraction of the time and allocations of `gumbo_parse`, which has to handle any
+// HTML. Parsing fails on anything unexpected, and the HTML should then be parsed with Gumbo instead.
+class MarkupParser {
+    std::string_view html;
+    size_t position = 0;
+    Markup &out;
+    // The open elements, innermost last, with their names and last children.
+    struct Open {
+        int node;
+        std::string_view name;
+        int lastChild;
+    };
+    std::vector<Open> open;
+
+    static bool isVoid(GumboTag tag) {
+        switch (tag) {
+            case GUMBO_TAG_AREA:
+            case GUMBO_TAG_BASE:
+            case GUMBO_TAG_BR:
+            case GUMBO_TAG_COL:
+            case GUMBO_TAG_EMBED:
+            case GUMBO_TAG_HR:
+            case GUMBO_TAG_IMG:
+            case GUMBO_TAG_INPUT:
+            case GUMBO_TAG_LINK:
+            case GUMBO_TAG_META:
+            case GUMBO_TAG_PARAM:
+            case GUMBO_TAG_SOURCE:
+            case GUMBO_TAG_TRACK:
+            case GUMBO_TAG_WBR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Appends `raw` to `text`, replacing character references. Only those which MediaWiki emits are known. Returns
+    // false on others.
+    static bool decodeTo(std::string_view raw, std::string &text) {
+        size_t reference = raw.find('&');
+        text.append(raw.substr(0, reference));
+        while (reference != std::string_view::npos) {
+            size_t end = raw.find(';', reference);
+            if (end == std::string_view::npos || end - reference > 10) return false;
+            std::string_view name = raw.substr(reference + 1, end - reference - 1);
+            if (name == "amp") {
+                text += '&';
+            } else if (name == "lt") {
+                text += '<';
+            } else if (name == "gt") {
+                text += '>';
+            } else if (name == "quot") {
+                text += '"';
+            } else if (name == "apos") {
+                text += '\'';
+            } else if (name == "nbsp") {
+                text += "\u00A0";
+            } else if (name.size() >= 2 && name[0] == '#') {
+                bool hex = name[1] == 'x' || name[1] == 'X';
+                unsigned long code = 0;
+                auto digits = name.substr(hex ? 2 : 1);
+                auto [last, error] = std::from_chars(digits.data(), digits.data() + digits.size(), code, hex ? 16 : 10);
+                if (error != std::errc() || last != digits.data() + digits.size() || code == 0 || code > 0x10FFFF) return false;
+                appendUTF8(text, (uint32_t)code);
+            } else {
+                return false;
+            }
+            reference = raw.find('&', end + 1);
+            text += raw.substr(end + 1, (reference == std::string_view::npos ? raw.size() : reference) - end - 1);
+        }
+        return true;
+    }
+
+    // Copies `raw` to the pool, see `decodeTo`.
+    bool decode(std::string_view raw, Markup::Span &result) {
+        size_t start = out.pool.size();
+        if (!decodeTo(raw, out.pool)) return false;
+        result = {(uint32_t)start, (uint32_t)(out.pool.size() - start)};
+        return true;
+    }
+
+    void append(const Markup::Node &node, bool isOpen = false, std::string_view name = {}) {
+        auto &parent = open.back();
+        int index = out.Append(node, parent.node, parent.lastChild);
+        parent.lastChild = index;
+        if (isOpen) open.push_back({index, name, -1});
+    }
+
+    bool text(std::string_view raw) {
+        if (raw.empty()) return true;
+        Markup::Node node;
+        node.type = Markup::IsWhitespace(raw) ? Markup::Whitespace : Markup::Text;
+        if (node.type == Markup::Text && !decode(raw, node.text)) return false;
+        append(node);
+        return true;
+    }
+
+    static bool isNameChar(char c) {
+        return std::isalnum((unsigned char)c) || c == '-' || c == ':' || c == '_';
+    }
+
+    size_t skipSpace(size_t i) const {
+        while (i < html.size() && std::isspace((unsigned char)html[i])) i++;
+        return i;
+    }
+
+    // Parses a start tag at `position`, which is after the `<`. Returns false if it isn't as expected.
+    bool startTag() {
+        size_t nameEnd = position;
+        while (nameEnd < html.size() && isNameChar(html[nameEnd])) nameEnd++;
+        std::string_view name = html.substr(position, nameEnd - position);
+        Markup::Node node;
+        node.tag = gumbo_tagn_enum(name.data(), (unsigned int)name.size());
+        size_t i = nameEnd;
+        bool selfClosing = false;
+        while (true) {
+            i = skipSpace(i);
+            if (i >= html.size()) return false;
+            if (html[i] == '>') break;
+            if (html[i] == '/') {
+                if (i + 1 >= html.size() || html[i + 1] != '>') return false;
+                selfClosing = true;
+                i++;
+                break;
+            }
+            size_t attributeEnd = i;
+            while (attributeEnd < html.size() && html[attributeEnd] != '=' && html[attributeEnd] != '>' && html[attributeEnd] != '/'
+                    && !std::isspace((unsigned char)html[attributeEnd])) {
+                attributeEnd++;
+            }
+            if (attributeEnd == i) return false;
+            std::string_view attribute = html.substr(i, attributeEnd - i);
+            i = skipSpace(attributeEnd);
+            std::string_view value;
+            if (i < html.size() && html[i] == '=') {
+                i = skipSpace(i + 1);
+                if (i >= html.size() || (html[i] != '"' && html[i] != '\'')) return false;
+                size_t valueEnd = html.find(html[i], i + 1);
+                if (valueEnd == std::string_view::npos) return false;
+                value = html.substr(i + 1, valueEnd - i - 1);
+                i = valueEnd + 1;
+            }
+            if (attribute == "class") {
+                node.classes = Markup::ClassOf(value);
+            } else if (attribute == "href" || (attribute == "id" && node.tag == GUMBO_TAG_SPAN)) {
+                if (!decode(value, node.text)) return false;
+            } else if (attribute == "colspan") {
+                node.colspan = Markup::ParseSpan(value);
+            } else if (attribute == "rowspan") {
+                node.rowspan = Markup::ParseSpan(value);
+            }
+        }
+        position = i + 1;
+        if (open.empty()) {
+            // The first element is the content itself.
+            if (node.tag != GUMBO_TAG_DIV || node.classes != Markup::ParserOutput || selfClosing) return false;
+            open.push_back({out.Append(node, -1, -1), name, -1});
+            return true;
+        }
+        if ((node.tag == GUMBO_TAG_TR && open.back().name == "table") || node.tag == GUMBO_TAG_TEXTAREA || node.tag == GUMBO_TAG_TITLE) {
+            // These would need Gumbo's tree construction rules.
+            return false;
+        }
+        if (selfClosing || isVoid(node.tag)) {
+            append(node);
+            return true;
+        }
+        append(node, true, name);
+        if (node.tag == GUMBO_TAG_SCRIPT || node.tag == GUMBO_TAG_STYLE) {
+            // Raw text, up to the end tag.
+            size_t end = html.find("</", position);
+            while (end != std::string_view::npos && html.substr(end + 2, name.size()) != name) {
+                end = html.find("</", end + 2);
+            }
+            if (end == std::string_view::npos) return false;
+            Markup::Node raw;
+            raw.type = Markup::Text;
+            if (end > position) {
+                raw.text = out.Store(html.substr(position, end - position));
+                append(raw);
+            }
+            position = end + 1;
+            return endTag();
+        }
+        return true;
+    }
+
+    // Parses an end tag at `position`, which is at the `/`. It must close the innermost open element.
+    bool endTag() {
+        size_t nameEnd = position + 1;
+        while (nameEnd < html.size() && isNameChar(html[nameEnd])) nameEnd++;
+        std::string_view name = html.substr(position + 1, nameEnd - position - 1);
+        size_t end = skipSpace(nameEnd);
+        if (end >= html.size() || html[end] != '>' || open.empty() || open.back().name != name) return false;
+        open.pop_back();
+        position = end + 1;
+        return true;
+    }
+
+    bool parse() {
+        size_t start = SectionScanner::ContentStart(html);
+        if (start == std::string_view::npos) return false;
+        position = start;
+        while (true) {
+            size_t tag = html.find('<', position);
+            if (open.empty() && tag != position) return false;
+            if (!text(html.substr(position, std::min(tag, html.size()) - position))) return false;
+            if (tag == std::string_view::npos) {
+                // The content is cut off after the last section, as in the first part of a split page.
+                return open.size() == 1;
+            }
+            position = tag + 1;
+            if (html.compare(position, 3, "!--") == 0) {
+                size_t end = html.find("-->", position + 3);
+                if (end == std::string_view::npos) return false;
+                position = end + 3;
+            } else if (position < html.size() && html[position] == '/') {
+                if (!endTag()) return false;
+                if (open.empty()) return true;
+            } else if (position < html.size() && std::isalpha((unsigned char)html[position])) {
+                if (!startTag()) return false;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    MarkupParser(std::string_view html, Markup &out) : html(html), out(out) {}
+
+public:
+    // Returns the text with its character references replaced, as they are in parsed text, or unchanged if it contains
+    // unknown ones.
+    static std::string Decode(std::string_view raw) {
+        std::string text;
+        return decodeTo(raw, text) ? text : std::string(raw);
+    }
+
+    // Returns false if the HTML has to be parsed with Gumbo, in which case `out` is left empty.
+    static bool Parse(std::string_view html, Markup &out) {
+        MarkupParser parser(html, out);
+        if (parser.parse()) return true;
+        out = Markup();
+        return false;
+    }
+};
+
+// Language names interned to small IDs, shared by all pages, so that sections can be matched with the default language
+// without comparing names. IDs are never reused.
+class Languages {
+    static inline std::mutex mutex;
+    static inline std::unordered_map<std::string, int> ids;
+
+public:
+    static int Intern(std::string_view name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return ids.try_emplace(std::string(name), (int)ids.size()).first->second;
+    }
+};
+
+// A parsed and lowered page. It is built on the task pool and never modified afterwards, so the UI thread
+// can read it without synchronization.
+struct Page {
+    // Commands between a language heading and the next one. The first section has no heading if there is content
+    // before the first language.
+    struct Section {
+        int heading = -1; // Index of the `LanguageHeading` or `Separator` command, -1 if there's none.
+        int begin = 0, end = 0; // Range of the blocks.
+        int deferred = -1; // The part of the page to lower when the section is first expanded, -1 if it's lowered.
+        int language = -1; // ID of the language from `Languages`, -1 if the section has no language heading.
+    };
+
+    bool hasContent = false;
+    bool partial = false; // True if the page only contains a section, shown while the rest is downloading.
+    std::vector<DisplayCommand> commands;
+    // The text of all the commands, one after another. Every text is followed by a null character, so it can also be
+    // passed to functions taking C strings.
+    std::string pool;
+    // Blocks are the units of virtualized scrolling. Block `i` consists of commands from `blocks[i]` up to
+    // `blocks[i + 1]`. The last element is the number of commands.
+    std::vector<int> blocks;
+    std::vector<Section> sections;
+    int languages = 0; // Sections with a language heading.
+    // Links to other entries, in the order of the commands containing them.
+    struct Link {
+        int command;
+        std::string title;
+    };
+    std::vector<Link> links;
+
+    std::string_view TextOf(const DisplayCommand &command) const {
+        return std::string_view(pool.data() + command.text, command.length);
+    }
+
+    // Appends a command with the text, see `StoreText`.
+    DisplayCommand &AddText(DisplayCommand::Kind kind, std::string_view text) {
+        auto &command = commands.emplace_back(kind);
+        StoreText(command, text);
+        return command;
+    }
+
+    // Sets the text of the command, with its whitespace normalized, see `AppendNormalized`.
+    void StoreText(DisplayCommand &command, std::string_view text) {
+        command.text = (int)pool.size();
+        AppendNormalized(pool, text);
+        command.length = (int)pool.size() - command.text;
+        pool += '\0';
+    }
+
+    // Appends a `LanguageHeading` with the name of the language. `value` and `span` are the offset and the length of
+    // the section's anchor in the pool, which identifies the section even if its name is spelled differently.
+    DisplayCommand &AddLanguageHeading(std::string_view name, std::string_view anchor) {
+        auto &command = AddText(DisplayCommand::LanguageHeading, name);
+        command.value = (int)pool.size();
+        command.span = (int)anchor.size();
+        pool.append(anchor);
+        pool += '\0';
+        return command;
+    }
+
+    std::string_view AnchorOf(const DisplayCommand &command) const {
+        return std::string_view(pool.data() + command.value, command.span);
+    }
+
+    // Appends the text to `out` with its whitespace normalized: every run of whitespace is replaced with a line break
+    // if it contains one, or a space otherwise, and whitespace at either end is dropped.
+    static void AppendNormalized(std::string &out, std::string_view text) {
+        size_t start = out.size();
+        bool space = false, lineBreak = false;
+        for (char c : text) {
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+                space = true;
+                lineBreak |= c == '\n';
+                continue;
+            }
+            if (space && out.size() > start) out += lineBreak ? '\n' : ' ';
+            space = lineBreak = false;
+            out += c;
+        }
+    }
+};
+
+// Heights of the blocks of a page as displayed in a tab, used to replace the blocks outside of the visible region
+// with empty space. Blocks are measured each time they are displayed, until then the height is estimated.
+struct PageLayout {
+    std::vector<float> heights;
+    std::vector<float> offsets; // offsets[i] is the sum of the heights of blocks before block `i`.
+    bool dirty = true;
+    // Heights of the rows of tables, by the index of their `TableRow` command. `rowOffsets` are the sums of the heights
+    // of the rows before each row of a table, and the height of the table at its `TableEnd`.
+    std::vector<float> rowHeights;
+    std::vector<float> rowOffsets;
+
+    // Lines of the wrapped texts, computed when a text is displayed for the first time at its current width.
+    struct Wrap {
+        float width = -1.0f; // The width the text was wrapped at.
+        float textWidth = 0.0f; // The width of the longest line.
+        int begin = 0, count = 0; // Range of `lines`.
+    };
+    struct Line {
+        int begin, end; // Range of the page's pool.
+    };
+    std::vector<Wrap> wraps; // By command.
+    std::vector<Line> lines;
+    int staleLines = 0; // Lines no longer referenced by `wraps`, after their texts were wrapped again.
+    // The font `wraps` are valid for.
+    ImFont *font = nullptr;
+    float fontSize = 0.0f;
+};
+
+class WiktionaryProvider {
+    // HTML structure:
+    // (#mw-content-text > .mw-parser-output)
+    //   See also: [.disambig-see-also-2 a]
+    //   Language heading: (h2 > .mw-headline)
+    //   Content
+    // Without the skin (`Source::Render` and `Source::Section`), `.mw-parser-output` is a child of `body`.
+
+    static GumboNode *findContent(GumboNode *root) {
+        if (root->type != GUMBO_NODE_ELEMENT) return nullptr;
+        GumboNode *node = root;
+        node = HTML::queryNode(node, {"body", "#content", "#bodyContent", "#mw-content-text", ".mw-parser-output"});
+        if (node == nullptr) {
+            node = HTML::queryNode(root, {"body", ".mw-parser-output"});
+        }
+        if (node == nullptr || node->type != GUMBO_NODE_ELEMENT || !gumboElementClassEquals(&node->v.element, "mw-parser-output")) return nullptr;
+        return node;
+    }
+
+    // Copies the node and its descendants from Gumbo's tree, as the next sibling of `previous` or the first child of
+    // `parent`. Returns the index of the copy, or `previous` if the node is skipped.
+    static int convertGumbo(GumboNode *node, Markup &out, int parent, int previous) {
+        Markup::Node converted;
+        switch (node->type) {
+            case GUMBO_NODE_TEXT:
+            case GUMBO_NODE_CDATA:
+                converted.type = Markup::Text;
+                converted.text = out.Store(safeCharPtr(node->v.text.text));
+                break;
+            case GUMBO_NODE_WHITESPACE:
+                converted.type = Markup::Whitespace;
+                break;
+            case GUMBO_NODE_ELEMENT:
+            case GUMBO_NODE_TEMPLATE: {
+                auto &attributes = node->v.element.attributes;
+                converted.tag = node->v.element.tag;
+                if (auto cl = gumbo_get_attribute(&attributes, "class")) converted.classes = Markup::ClassOf(cl->value);
+                if (auto href = gumbo_get_attribute(&attributes, "href")) converted.text = out.Store(href->value);
+                if (converted.tag == GUMBO_TAG_SPAN) {
+                    if (auto id = gumbo_get_attribute(&attributes, "id")) converted.text = out.Store(id->value);
+                }
+                if (auto colspan = gumbo_get_attribute(&attributes, "colspan")) converted.colspan = Markup::ParseSpan(colspan->value);
+                if (auto rowspan = gumbo_get_attribute(&attributes, "rowspan")) converted.rowspan = Markup::ParseSpan(rowspan->value);
+                break;
+            }
+            default:
+                return previous;
+        }
+        int index = out.Append(converted, parent, previous);
+        if (converted.type == Markup::Element) {
+            int last = -1;
+            gumboForEachChild(node->v.element.children) {
+                last = convertGumbo(*child, out, index, last);
+            }
+        }
+        return index;
+    }
+
+    // Returns the text of the heading's `.mw-headline`, or an empty view if it can't be found.
+    static std::string_view getHeaderText(const Markup &markup, int heading) {
+        markupForEachChild(markup, heading) {
+            if (markup.types[child] != Markup::Element || !markup.HasClass(child, Markup::Headline)) continue;
+            int text = markup.firstChildren[child];
+            if (text >= 0 && markup.types[text] == Markup::Text) {
+                return markup.TextOf(text);
+            }
+            break;
+        }
+        // Couldn't find the text.
+        return {};
+    }
+
+    // Returns the id of the heading's `.mw-headline`, as `SectionScanner::HeadingAnchor` finds it.
+    static std::string_view getHeaderAnchor(const Markup &markup, int heading) {
+        markupForEachChild(markup, heading) {
+            if (markup.types[child] == Markup::Element && markup.HasClass(child, Markup::Headline)) {
+                return markup.IdOf(child);
+            }
+        }
+        return {};
+    }
+
+    static std::string_view safeText(std::string_view text) {
+        return text.empty() ? std::string_view(fallbackText) : text;
+    }
+
+    // Adds the target of the link to the page's links if it's another entry. The link belongs to the next command.
+    static void collectLink(const Markup &markup, int a, Page &out) {
+        std::string_view href = markup.HrefOf(a);
+        if (href.substr(0, 6) != "/wiki/") return;
+        std::string_view target = href.substr(6);
+        target = target.substr(0, target.find('#'));
+        // Other namespaces, like Appendix: or Category:
+        if (target.empty() || target.find(':') != std::string_view::npos) return;
+        out.links.push_back({(int)out.commands.size(), urlDecode(target)});
+    }
+
+    // Appends the text of the node and its children to `text`. The links are added to `out`, unless it's null.
+    static void extractText(const Markup &markup, int node, std::string &text, Page *out) {
+        if (markup.types[node] == Markup::Text) {
+            text += markup.TextOf(node);
+        } else if (markup.types[node] == Markup::Whitespace) {
+            text += " ";
+        } else {
+            markupForEachChild(markup, node) {
+                if (markup.types[child] != Markup::Element) {
+                    extractText(markup, child, text, out);
+                    continue;
+                }
+                if (markup.HasClass(child, Markup::AudioTable)) continue;
+                if (out != nullptr && markup.tags[child] == GUMBO_TAG_A) collectLink(markup, child, *out);
+                switch (markup.tags[child]) {
+                    // ignore
+                    case GUMBO_TAG_STYLE:
+                        break;
+                    // inline
+                    case GUMBO_TAG_SPAN:
+                    case GUMBO_TAG_I:
+                    case GUMBO_TAG_A:
+                    case GUMBO_TAG_B:
+                    case GUMBO_TAG_EM:
+                    case GUMBO_TAG_U:
+                    case GUMBO_TAG_STRONG:
+                    case GUMBO_TAG_SUB:
+                    case GUMBO_TAG_SUP:
+                    case GUMBO_TAG_ABBR:
+                        extractText(markup, child, text, out);
+                        break;
+                    // block
+                    default:
+                        if (!text.empty() && text[text.length() - 1] != '\n') {
+                            text += '\n';
+                        }
+                        extractText(markup, child, text, out);
+                        break;
+                }
+            }
+        }
+    }
+
+    // The `lower*` functions convert the content of the page into display commands. They run once per page, the
+    // result is replayed by `displayCommands`.
+
+    static void lowerList(const Markup &markup, int list, Page &out, bool ordered = false) {
+        int counter = 0;
+        markupForEachChild(markup, list) {
+            std::string text;
+            if (markup.types[child] == Markup::Element) {
+                switch (markup.tags[child]) {
+                    case GUMBO_TAG_LI:
+                    case GUMBO_TAG_DD:
+                    case GUMBO_TAG_DT:
+                        if (markup.HasClass(child, Markup::EmptyElement)) continue;
+                        extractText(markup, child, text, &out);
+                        if (text.empty()) continue;
+                        counter++;
+                        if (ordered) {
+                            out.commands.emplace_back(DisplayCommand::Number, counter);
+                        } else {
+                            out.commands.emplace_back(DisplayCommand::Bullet);
+                        }
+                        out.AddText(DisplayCommand::WrappedText, text);
+                        break;
+                    default:
+                        extractText(markup, child, text, &out);
+                        out.AddText(DisplayCommand::WrappedText, text);
+                }
+            }
+        }
+    }
+
+    static void lowerDefinition(const Markup &markup, int item, Page &out) {
+        std::string text;
+        markupForEachChild(markup, item) {
+            if (markup.types[child] == Markup::Text) {
+                text += markup.TextOf(child);
+            } else if (markup.types[child] == Markup::Whitespace) {
+                text += ' ';
+            } else {
+                // `extractText` only collects the links among the children of the node it's given.
+                if (markup.tags[child] == GUMBO_TAG_A) collectLink(markup, child, out);
+                switch (markup.tags[child]) {
+                    // ignore
+                    case GUMBO_TAG_STYLE:
+                        break;
+                    // special
+                    case GUMBO_TAG_DL:
+                    case GUMBO_TAG_UL: // TODO: If only quotations are in unordered lists, then make them collapsed by default.
+                        for (auto &c : text) {
+                            if (c != ' ' && c != '\n') {
+                                out.AddText(DisplayCommand::WrappedText, text);
+                                text.clear();
+                                break;
+                            }
+                        }
+                        out.commands.emplace_back(DisplayCommand::Indent, 10);
+                        lowerList(markup, child, out);
+                        out.commands.emplace_back(DisplayCommand::Unindent, 10);
+                        break;
+                    // inline
+                    case GUMBO_TAG_SPAN:
+                    case GUMBO_TAG_I:
+                    case GUMBO_TAG_A:
+                    case GUMBO_TAG_B:
+                    case GUMBO_TAG_EM:
+                    case GUMBO_TAG_U:
+                    case GUMBO_TAG_STRONG:
+                    case GUMBO_TAG_SUB:
+                    case GUMBO_TAG_SUP:
+                    case GUMBO_TAG_ABBR:
+                        extractText(markup, child, text, &out);
+                        break;
+                    // block
+                    default:
+                        if (!text.empty() && text[text.length() - 1] != '\n') text += '\n';
+                        extractText(markup, child, text, &out);
+                        break;
+                }
+            }
+        }
+        if (!text.empty()) {
+            out.AddText(DisplayCommand::WrappedText, text);
+        }
+    }
+
+    static void lowerDefinitions(const Markup &markup, int list, Page &out) {
+        int counter = 0;
+        markupForEachChild(markup, list) {
+            std::string text;
+            if (markup.types[child] == Markup::Element) {
+                if (markup.tags[child] == GUMBO_TAG_LI) {
+                    if (markup.HasClass(child, Markup::EmptyElement)) continue;
+                    // Only checks that there is some text, the links are collected by `lowerDefinition`.
+                    extractText(markup, child, text, nullptr);
+                    if (text.empty()) continue;
+                    counter++;
+                    out.commands.emplace_back(DisplayCommand::Number, counter);
+                    lowerDefinition(markup, child, out);
+                } else {
+                    extractText(markup, child, text, &out);
+                    out.AddText(DisplayCommand::WrappedText, "." + text);
+                }
+            }
+        }
+    }
+
+    static bool isTableCell(const Markup &markup, int node) {
+        return markup.IsElement(node, GUMBO_TAG_TH) || markup.IsElement(node, GUMBO_TAG_TD);
+    }
+
+    // Lowers the row into a `TableRow` and a `TableCell` for every column, so that rows can be found by their index.
+    // Columns covered by a cell spanning them, from this row or one above, get an empty cell.
+    static void lowerTableRow(const Markup &markup, int tr, int columns, std::vector<int> &rowspans, Page &out) {
+        if (markup.HasClass(tr, Markup::CollapsedRow)) {
+            // These rows are displayed when the table is collapsed.
+            return;
+        }
+        int row = (int)out.commands.size();
+        auto skipTo = [row, &out](int column) {
+            for (int i = (int)out.commands.size() - row - 1; i < column; i++) {
+                out.commands.emplace_back(DisplayCommand::TableCell, i);
+            }
+        };
+        int column = 0, width;
+        out.commands.emplace_back(DisplayCommand::TableRow);
+        markupForEachChild(markup, tr) {
+            if (isTableCell(markup, child)) {
+                if (column >= columns) goto endRow;
+                while (rowspans[column] > 0) {
+                    rowspans[column]--;
+                    column++;
+                    if (column >= columns) goto endRow;
+                }
+                skipTo(column);
+                std::string text;
+                extractText(markup, child, text, &out);
+                width = std::clamp((int)markup.colspans[child], 1, columns - column); // colspan="0" is taken as 1.
+                auto &cell = out.AddText(DisplayCommand::TableCell, text);
+                cell.value = column;
+                cell.span = width;
+                for (int i = 0; i < width; i++) {
+                    rowspans[column + i] = markup.rowspans[child] - 1;
+                }
+                column += width;
+            }
+        }
+    endRow:
+        skipTo(columns);
+        for (int i = column; i < columns; i++) {
+            rowspans[i]--;
+        }
+    }
+
+    // Returns the number of columns. If it can't be retrieved, the function returns a negative value.
+    // It may also return 0.
+    static int getTableWidth(const Markup &markup, int tbody) {
+        int firstRow = -1;
+        markupForEachChild(markup, tbody) {
+            if (markup.IsElement(child, GUMBO_TAG_TR)) {
+                firstRow = child;
+                break;
+            }
+        }
+        if (firstRow < 0) return -1;
+        int columns = 0;
+        markupForEachChild(markup, firstRow) {
+            if (isTableCell(markup, child)) {
+                columns += markup.colspans[child];
+            }
+        }
+        return columns;
+    }
+
+    static void lowerTable(const Markup &markup, int tbody, Page &out) {
+        int columns = getTableWidth(markup, tbody);
+        if (columns <= 0) {
+            out.AddText(DisplayCommand::Text, "(Invalid table)");
+            return;
+        }
+        size_t begin = out.commands.size();
+        out.commands.emplace_back(DisplayCommand::TableBegin, columns);
+        std::vector<int> rowspans(columns, 0); // rowspans[i] = x means to skip the ith column in next x rows.
+        markupForEachChild(markup, tbody) {
+            if (markup.IsElement(child, GUMBO_TAG_TR)) {
+                lowerTableRow(markup, child, columns, rowspans, out);
+            }
+        }
+        out.commands[begin].span = (int)(out.commands.size() - begin - 1) / (columns + 1);
+        out.commands.emplace_back(DisplayCommand::TableEnd);
+        out.commands[begin].next = (int)out.commands.size();
+    }
+
+    static void lowerRecursive(const Markup &markup, int node, Page &out) {
+        if (markup.types[node] == Markup::Text) {
+            out.AddText(DisplayCommand::Text, markup.TextOf(node));
+        } else if (markup.types[node] == Markup::Element) {
+            std::string text;
+            // TODO: div.list-switcher (multi-column ul)
+            switch (markup.tags[node]) {
+                case GUMBO_TAG_STYLE:
+                case GUMBO_TAG_DIV: // TODO: Should there be any exceptions to this?
+                    break;
+                case GUMBO_TAG_H3:
+                    out.AddText(DisplayCommand::Heading, safeText(getHeaderText(markup, node)));
+                    break;
+                case GUMBO_TAG_H4:
+                case GUMBO_TAG_H5:
+                case GUMBO_TAG_H6:
+                    out.AddText(DisplayCommand::Subheading, safeText(getHeaderText(markup, node)));
+                    break;
+                case GUMBO_TAG_P:
+                    extractText(markup, node, text, &out);
+                    out.AddText(DisplayCommand::WrappedText, text);
+                    break;
+                case GUMBO_TAG_UL:
+                    lowerList(markup, node, out);
+                    break;
+                case GUMBO_TAG_OL: // I hope that ordered lists always contain definitions...
+                    lowerDefinitions(markup, node, out);
+                    break;
+                case GUMBO_TAG_HR:
+                    break;
+                case GUMBO_TAG_TBODY:
+                    lowerTable(markup, node, out);
+                    break;
+                default:
+                    markupForEachChild(markup, node) {
+                        lowerRecursive(markup, child, out);
+                    }
+                    break;
+            }
+        }
+    }
+
+    // Lowers the children of `.mw-parser-output`, the first node of the markup.
+    static void lowerContent(const Markup &markup, Page &out) {
+        bool firstHeading = true;
+        markupForEachChild(markup, 0) {
+            if (markup.IsElement(child, GUMBO_TAG_H2)) {
+                auto text = getHeaderText(markup, child);
+                if (text.empty()) {
+                    out.commands.emplace_back(DisplayCommand::Separator);
+                } else {
+                    out.AddLanguageHeading(text, getHeaderAnchor(markup, child));
+                }
+                firstHeading = true;
+            } else if (firstHeading && markup.IsElement(child, GUMBO_TAG_H3)) {
+                out.AddText(DisplayCommand::FirstHeading, safeText(getHeaderText(markup, child)));
+                firstHeading = false;
+            } else {
+                lowerRecursive(markup, child, out);
+            }
+        }
+    }
+
+    // Splits the commands into blocks and groups them into sections. A block starts with every command at the top
+    // nesting level, except for the content following a bullet or a number, which stays on the same line. Language
+    // headings form blocks of their own, which don't belong to any section's range.
+    static void splitBlocks(Page &page) {
+        auto &commands = page.commands;
+        int depth = 0;
+        page.sections.emplace_back();
+        for (int i = 0; i < (int)commands.size(); i++) {
+            auto kind = commands[i].kind;
+            if (kind == DisplayCommand::LanguageHeading || kind == DisplayCommand::Separator) {
+                page.sections.back().end = (int)page.blocks.size();
+                page.blocks.push_back(i);
+                auto &section = page.sections.emplace_back();
+                section.heading = i;
+                section.begin = (int)page.blocks.size();
+                if (kind == DisplayCommand::LanguageHeading) {
+                    section.language = Languages::Intern(page.TextOf(commands[i]));
+                    page.languages++;
+                }
+                continue;
+            }
+            bool sameLine = i > 0 && (commands[i - 1].kind == DisplayCommand::Bullet || commands[i - 1].kind == DisplayCommand::Number);
+            if (depth == 0 && !sameLine) {
+                page.blocks.push_back(i);
+            }
+            if (kind == DisplayCommand::Indent || kind == DisplayCommand::TableBegin) depth++;
+            if (kind == DisplayCommand::Unindent || kind == DisplayCommand::TableEnd) depth--;
+        }
+        page.sections.back().end = (int)page.blocks.size();
+        page.blocks.push_back((int)commands.size());
+        if (page.sections.front().begin == page.sections.front().end) {
+            page.sections.erase(page.sections.begin());
+        }
+    }
+
+    // Splits the text of the command into lines which fit in `width`, at the same positions as `ImGui::TextWrapped`.
+    // Line breaks in the text always start a new line.
+    static void wrapText(const Page &page, PageLayout &layout, int command, float width) {
+        auto &wrap = layout.wraps[command];
+        layout.staleLines += wrap.count;
+        wrap.width = width;
+        wrap.textWidth = 0.0f;
+        wrap.begin = (int)layout.lines.size();
+        ImFont *font = layout.font;
+        float scale = layout.fontSize / font->FontSize;
+        auto text = page.TextOf(page.commands[command]);
+        const char *pool = page.pool.data(), *s = text.data(), *end = text.data() + text.size();
+        do {
+            const char *paragraphEnd = std::find(s, end, '\n');
+            do {
+                const char *eol = font->CalcWordWrapPositionA(scale, s, paragraphEnd, width);
+                if (eol == s + 1 && (unsigned char)*s >= 0x80) {
+                    // ImGui breaks a character which doesn't fit on its own line after the first byte.
+                    unsigned int c;
+                    eol = s + ImTextCharFromUtf8(&c, s, paragraphEnd);
+                }
+                layout.lines.push_back({(int)(s - pool), (int)(eol - pool)});
+                wrap.textWidth = std::max(wrap.textWidth, font->CalcTextSizeA(layout.fontSize, FLT_MAX, 0.0f, s, eol).x);
+                s = eol;
+                while (s < paragraphEnd && (*s == ' ' || *s == '\t')) s++;
+            } while (s < paragraphEnd);
+            s = paragraphEnd + 1;
+        } while (s < end);
+        wrap.count = (int)layout.lines.size() - wrap.begin;
+    }
+
+    // Displays the text of the command like `ImGui::TextWrapped`, from the lines cached in the layout. Texts are only
+    // wrapped again when the width available to them or the font changes, e.g. when the window is resized.
+    static void displayWrapped(const Page &page, PageLayout &layout, int command) {
+        ImGuiWindow *window = ImGui::GetCurrentWindow();
+        if (window->SkipItems) return;
+        ImFont *font = ImGui::GetFont();
+        float fontSize = ImGui::GetFontSize();
+        // Lines of texts wrapped again are only dropped with the rest, once they are the majority.
+        if (layout.font != font || layout.fontSize != fontSize || layout.wraps.size() != page.commands.size()
+                || layout.staleLines * 2 > (int)layout.lines.size()) {
+            layout.wraps.assign(page.commands.size(), PageLayout::Wrap());
+            layout.lines.clear();
+            layout.staleLines = 0;
+            layout.font = font;
+            layout.fontSize = fontSize;
+        }
+        float wrapPos = std::max(window->DC.TextWrapPos, 0.0f);
+        float width = ImGui::CalcWrapWidthForPos(window->DC.CursorPos, wrapPos);
+        if (layout.wraps[command].width != width) {
+            wrapText(page, layout, command, width);
+        }
+        auto &wrap = layout.wraps[command];
+        ImVec2 position(window->DC.CursorPos.x, window->DC.CursorPos.y + window->DC.CurrLineTextBaseOffset);
+        ImVec2 size(std::floor(wrap.textWidth + 0.99999f), fontSize * (float)wrap.count);
+        ImGui::ItemSize(size, 0.0f);
+        if (!ImGui::ItemAdd(ImRect(position, ImVec2(position.x + size.x, position.y + size.y)), 0)) return;
+        // Only the lines in the clipping rectangle are drawn.
+        int first = std::max((int)((window->ClipRect.Min.y - position.y) / fontSize), 0);
+        int last = std::min((int)((window->ClipRect.Max.y - position.y) / fontSize) + 1, wrap.count);
+        ImU32 color = ImGui::GetColorU32(ImGuiCol_Text);
+        for (int i = first; i < last; i++) {
+            auto &line = layout.lines[wrap.begin + i];
+            window->DrawList->AddText(font, fontSize, ImVec2(position.x, position.y + fontSize * (float)i), color,
+                                      page.pool.data() + line.begin, page.pool.data() + line.end);
+        }
+    }
+
+    // Displays the `TableRow` command at `row` and the cells following it.
+    static void displayTableRow(const Page &page, PageLayout &layout, int row, int columns) {
+        ImGui::TableNextRow();
+        for (int i = row + 1; i <= row + columns; i++) {
+            auto &cell = page.commands[i];
+            if (cell.span == 0) continue;
+            ImGui::TableSetColumnIndex(cell.value);
+            ImGui::PushTextWrapPos(ImGui::GetCursorPosX() + (float)cell.span * ImGui::GetColumnWidth());
+            displayWrapped(page, layout, i);
+            ImGui::PopTextWrapPos();
+        }
+    }
+
+    // Sums the heights of the rows of the table starting at the `TableBegin` command `begin`, see `PageLayout::rowOffsets`.
+    static void updateRowOffsets(const Page &page, PageLayout &layout, int begin) {
+        auto &command = page.commands[begin];
+        int stride = command.value + 1, end = begin + 1 + command.span * stride;
+        layout.rowOffsets[begin + 1] = 0;
+        for (int row = begin + 1; row < end; row += stride) {
+            layout.rowOffsets[row + stride] = layout.rowOffsets[row] + layout.rowHeights[row];
+        }
+    }
+
+    // Moves the cursor of the current table down to `y`, past `rows` rows which aren't displayed, the way
+    // `ImGuiListClipper` does. The skipped rows still count for the alternating background colors.
+    static void skipTableRows(float y, int rows) {
+        ImGuiTable *table = ImGui::GetCurrentTable();
+        ImGuiWindow *window = table->InnerWindow;
+        if (table->IsInsideRow) ImGui::TableEndRow(table);
+        window->DC.CursorPos.y = table->RowPosY2 = y;
+        window->DC.CursorMaxPos.y = std::max(window->DC.CursorMaxPos.y, y);
+        table->RowBgColorCounter += rows;
+    }
+
+    // Displays the rows of the table starting at the `TableBegin` command `begin` which intersect [`visibleTop`,
+    // `visibleBottom`), in screen coordinates. The others are skipped using their heights in the layout, like the
+    // blocks in `displayBlocks`, so that rows of different heights don't move the scrollbar.
+    static void displayTableRows(const Page &page, PageLayout &layout, int begin, float visibleTop, float visibleBottom) {
+        auto &command = page.commands[begin];
+        int columns = command.value, rows = command.span, stride = columns + 1;
+        auto rowCommand = [begin, stride](int row) { return begin + 1 + row * stride; };
+        auto &offsets = layout.rowOffsets;
+        float top = ImGui::GetCurrentTable()->RowPosY2;
+        // First row ending below the top of the visible region.
+        int first = 0, last = rows;
+        while (first < last) {
+            int middle = (first + last) / 2;
+            if (top + offsets[rowCommand(middle + 1)] <= visibleTop) first = middle + 1; else last = middle;
+        }
+        skipTableRows(top + offsets[rowCommand(first)], first);
+        ImGuiTable *table = ImGui::GetCurrentTable();
+        bool dirty = false;
+        int row = first;
+        for (; row < rows && table->RowPosY2 < visibleBottom; row++) {
+            int i = rowCommand(row);
+            displayTableRow(page, layout, i, columns);
+            ImGui::TableEndRow(table);
+            float height = table->RowPosY2 - table->RowPosY1;
+            if (height != layout.rowHeights[i]) {
+                layout.rowHeights[i] = height;
+                dirty = true;
+            }
+        }
+        if (dirty) updateRowOffsets(page, layout, begin);
+        skipTableRows(top + offsets[rowCommand(rows)], rows - row);
+    }
+
+    // Replays the commands in range [`begin`, `end`). Language headings are handled by `displayPage`.
+    static void displayCommands(const Page &page, PageLayout &layout, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            auto &command = page.commands[i];
+            auto text = page.TextOf(command);
+            switch (command.kind) {
+                case DisplayCommand::LanguageHeading:
+                case DisplayCommand::Separator:
+                    break;
+                case DisplayCommand::Heading:
+                    ImGui::Dummy(ImVec2(0.0f, 0.5f * ImGui::GetTextLineHeightWithSpacing()));
+                    ImGui::Separator();
+                    ImGui::TextUnformatted(text.data(), text.data() + text.size());
+                    AddUnderline();
+                    break;
+                case DisplayCommand::Subheading:
+                    ImGui::Dummy(ImVec2(0.0f, 0.5f * ImGui::GetTextLineHeightWithSpacing()));
+                    ImGui::TextUnformatted(text.data(), text.data() + text.size());
+                    AddUnderline();
+                    break;
+                case DisplayCommand::FirstHeading:
+                    ImGui::TextUnformatted(text.data(), text.data() + text.size());
+                    AddUnderline();
+                    break;
+                case DisplayCommand::Text:
+                    ImGui::TextUnformatted(text.data(), text.data() + text.size());
+                    break;
+                case DisplayCommand::WrappedText:
+                    displayWrapped(page, layout, i);
+                    break;
+                case DisplayCommand::Bullet:
+                    ImGui::Bullet();
+                    break;
+                case DisplayCommand::Number:
+                    ImGui::Text("%d.", command.value);
+                    ImGui::SameLine(0, 0);
+                    break;
+                case DisplayCommand::Indent:
+                    ImGui::Indent((float)command.value);
+                    break;
+                case DisplayCommand::Unindent:
+                    ImGui::Unindent((float)command.value);
+                    break;
+                case DisplayCommand::TableBegin: {
+                    ImGui::PushID(i);
+                    ImRect visible = ImGui::GetCurrentWindow()->ClipRect;
+                    // Cells spanning several columns overflow into the next ones, so columns aren't clipped.
+                    if (ImGui::BeginTable("Table", command.value, ImGuiTableFlags_NoClip|ImGuiTableFlags_BordersOuter|ImGuiTableFlags_RowBg)) {
+                        displayTableRows(page, layout, i, visible.Min.y, visible.Max.y);
+                        ImGui::EndTable();
+                    }
+                    ImGui::PopID();
+                    i = command.next - 1;
+                    break;
+                }
+                case DisplayCommand::TableRow:
+                case DisplayCommand::TableCell:
+                case DisplayCommand::TableEnd:
+                    // Displayed with `TableBegin`.
+                    break;
+            }
+        }
+    }
+
+    // Estimates the heights of blocks and table rows which haven't been displayed yet, from the length of their text.
+    static void estimateLayout(const Page &page, PageLayout &layout) {
+        float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+        float charWidth = ImGui::CalcTextSize("M").x;
+        float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+        layout.heights.resize(page.blocks.size() - 1);
+        layout.rowHeights.assign(page.commands.size(), 0.0f);
+        layout.rowOffsets.assign(page.commands.size(), 0.0f);
+        int columns = 1;
+        for (size_t block = 0; block + 1 < page.blocks.size(); block++) {
+            float lines = 0;
+            for (int i = page.blocks[block]; i < page.blocks[block + 1]; i++) {
+                auto &command = page.commands[i];
+                switch (command.kind) {
+                    case DisplayCommand::Heading:
+                    case DisplayCommand::Subheading:
+                        lines += 1.5f;
+                        break;
+                    case DisplayCommand::FirstHeading:
+                    case DisplayCommand::Text:
+                    case DisplayCommand::WrappedText:
+                        lines += 1.0f + std::floor((float)command.length * charWidth / width);
+                        break;
+                    case DisplayCommand::TableBegin:
+                        columns = std::max(command.value, 1);
+                        break;
+                    case DisplayCommand::TableRow: {
+                        // As high as the cell with the most lines.
+                        float rowLines = 1.0f;
+                        for (int cell = i + 1; cell <= i + columns; cell++) {
+                            float cellWidth = std::max(width * (float)page.commands[cell].span / (float)columns, 1.0f);
+                            rowLines = std::max(rowLines, 1.0f + std::floor((float)page.commands[cell].length * charWidth / cellWidth));
+                        }
+                        layout.rowHeights[i] = rowLines * lineHeight;
+                        lines += rowLines;
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+            layout.heights[block] = lines * lineHeight;
+        }
+        for (int i = 0; i < (int)page.commands.size(); i++) {
+            if (page.commands[i].kind == DisplayCommand::TableBegin) updateRowOffsets(page, layout, i);
+        }
+        layout.dirty = true;
+    }
+
+    // Displays the blocks in range [`begin`, `end`) which intersect the visible region of the window. The others are
+    // replaced with empty space.
+    // The entries linked from the block under the mouse are prefetched.
+    void displayBlocks(const Page &page, PageLayout &layout, int begin, int end) {
+        if (layout.dirty) {
+            layout.offsets.resize(layout.heights.size() + 1);
+            layout.offsets[0] = 0;
+            for (size_t i = 0; i < layout.heights.size(); i++) {
+                layout.offsets[i + 1] = layout.offsets[i] + layout.heights[i];
+            }
+            layout.dirty = false;
+        }
+        float spacing = ImGui::GetStyle().ItemSpacing.y;
+        auto skip = [spacing](float height) {
+            if (height > spacing) ImGui::Dummy(ImVec2(0.0f, height - spacing));
+        };
+        float visibleTop = ImGui::GetScrollY();
+        float visibleBottom = visibleTop + ImGui::GetWindowHeight();
+        // First block ending below the top of the visible region.
+        float top = visibleTop - ImGui::GetCursorPosY() + layout.offsets[begin];
+        int block = (int)(std::upper_bound(layout.offsets.begin() + begin + 1, layout.offsets.begin() + end + 1, top) - layout.offsets.begin()) - 1;
+        block = std::min(block, end);
+        skip(layout.offsets[block] - layout.offsets[begin]);
+        bool hovered = ImGui::IsWindowHovered();
+        for (; block < end && ImGui::GetCursorPosY() <= visibleBottom; block++) {
+            float y = ImGui::GetCursorPosY();
+            ImVec2 min(ImGui::GetWindowPos().x, ImGui::GetCursorScreenPos().y);
+            displayCommands(page, layout, page.blocks[block], page.blocks[block + 1]);
+            float height = ImGui::GetCursorPosY() - y;
+            if (height != layout.heights[block]) {
+                layout.heights[block] = height;
+                layout.dirty = true;
+            }
+            if (hovered && ImGui::IsMouseHoveringRect(min, ImVec2(min.x + ImGui::GetWindowWidth(), min.y + height), false)) {
+                prefetchLinks(page, block);
+            }
+        }
+        skip(layout.offsets[end] - layout.offsets[block]);
+    }
+
+    struct Lookup;
+
+    // Displays a list of the languages on the page, if there are several. Returns the index of the section chosen from
+    // it, or -1.
+    static int displayLanguageList(const Page &page) {
+        if (page.languages < 2) return -1;
+        int chosen = -1;
+        ImGui::SetNextItemWidth(12.0f * ImGui::GetFontSize());
+        if (ImGui::BeginCombo("##Languages", "Go to language")) {
+            for (int i = 0; i < (int)page.sections.size(); i++) {
+                if (page.sections[i].language < 0) continue;
+                ImGui::PushID(i);
+                if (ImGui::Selectable(page.TextOf(page.commands[page.sections[i].heading]).data())) chosen = i;
+                ImGui::PopID();
+            }
+            ImGui::EndCombo();
+        }
+        return chosen;
+    }
+
+    // Sections which haven't been lowered yet are requested from the lookup when they are open. The section of the
+    // default language is open at first. If `resolveLanguages` is true, e.g. after the default language has changed,
+    // the other sections are closed and it's opened again.
+    void displayPage(const std::shared_ptr<Lookup> &lookup, const Page &page, PageLayout &layout, bool resolveLanguages) {
+        if (layout.heights.empty()) {
+            estimateLayout(page, layout);
+        }
+        int jump = displayLanguageList(page);
+        for (int i = 0; i < (int)page.sections.size(); i++) {
+            auto &section = page.sections[i];
+            bool open = true;
+            if (section.heading >= 0) {
+                auto &heading = page.commands[section.heading];
+                if (heading.kind == DisplayCommand::Separator) {
+                    ImGui::Separator();
+                } else {
+                    bool preferred = section.language == defaultLanguageId;
+                    if (resolveLanguages) ImGui::SetNextItemOpen(preferred);
+                    if (i == jump) ImGui::SetNextItemOpen(true);
+                    // Keyed by the anchor, so that the header keeps its state when the section is lowered.
+                    auto name = page.TextOf(heading), anchor = page.AnchorOf(heading);
+                    if (anchor.empty()) anchor = name;
+                    auto *window = ImGui::GetCurrentWindow();
+                    open = !window->SkipItems && ImGui::TreeNodeBehavior(window->GetID(anchor.data(), anchor.data() + anchor.size()),
+                        ImGuiTreeNodeFlags_CollapsingHeader | (preferred ? ImGuiTreeNodeFlags_DefaultOpen : 0), name.data(), name.data() + name.size());
+                    if (i == jump) ImGui::SetScrollHereY(0.0f);
+                }
+            }
+            if (open && section.deferred >= 0) {
+                expandSection(lookup, section.deferred);
+                displayLoadingIcon();
+            } else if (open) {
+                displayBlocks(page, layout, section.begin, section.end);
+            }
+        }
+    }
+
+    // How many documents were parsed by `MarkupParser`, and how many had to be parsed with Gumbo.
+    static inline std::atomic<uint64_t> fastParses{0}, gumboParses{0};
+
+    // Parses the response body with `MarkupParser` or, if it can't handle it, with Gumbo. Neither the body nor
+    // Gumbo's tree are needed afterwards.
+    static std::shared_ptr<Markup> parseDocument(std::string body) {
+        auto markup = std::make_shared<Markup>();
+        if (MarkupParser::Parse(body, *markup)) {
+            fastParses++;
+            return markup;
+        }
+        gumboParses++;
+        HTML html(body.data(), body.size());
+        if (auto content = findContent(html.output->root)) {
+            convertGumbo(content, *markup, -1, -1);
+        }
+        return markup;
+    }
+
+    // Lowers the content of the document into display commands. The commands aren't split into blocks yet.
+    static void lowerDocument(const Markup &markup, Page &out) {
+        if (markup.Empty()) return;
+        lowerContent(markup, out);
+        out.hasContent = true;
+    }
+
+    // Parses the response body and lowers it into display commands, in one go.
+    static std::shared_ptr<Page> buildPage(std::string body) {
+        auto page = std::make_shared<Page>();
+        lowerDocument(*parseDocument(std::move(body)), *page);
+        if (page->hasContent) splitBlocks(*page);
+        return page;
+    }
+
+    // Returns the positions of the language headings in the raw HTML. Other `h2` elements, like the table of contents
+    // heading, have no anchor and aren't children of `.mw-parser-output`, so the page can't be split at them.
+    static std::vector<size_t> findLanguageHeadings(std::string_view html) {
+        SectionScanner scanner;
+        scanner.Scan(html);
+        std::vector<size_t> headings;
+        for (size_t position : scanner.headings) {
+            if (!SectionScanner::HeadingAnchor(html, position).empty()) headings.push_back(position);
+        }
+        return headings;
+    }
+
+    // Where pages are requested from.
+    enum class Source : int {
+        Page,    // The whole skinned page, /wiki/<title>.
+        Render,  // Only the rendered content, index.php?action=render.
+        Section, // Only the section of the default language, through the parse API.
+    };
+
+    static std::string urlEncode(const std::string &text) {
+        std::string out;
+        for (unsigned char c : text) {
+            if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+                out += (char)c;
+            } else {
+                char escaped[4];
+                snprintf(escaped, sizeof(escaped), "%%%02X", c);
+                out += escaped;
+            }
+        }
+        return out;
+    }
+
+    static std::string urlDecode(std::string_view text) {
+        std::string out;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '%' && i + 2 < text.size() && std::isxdigit((unsigned char)text[i + 1]) && std::isxdigit((unsigned char)text[i + 2])) {
+                out += (char)std::stoi(std::string(text.substr(i + 1, 2)), nullptr, 16);
+                i += 2;
+            } else {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+
+    // Writes the title of the page as it appears in its URL to `title`: without surrounding whitespace and with spaces
+    // replaced by underscores.
+    static void canonicalTitle(const char *query, std::string &title) {
+        title.clear();
+        bool space = false;
+        for (const char *c = query; *c != '\0'; c++) {
+            if (std::isspace((unsigned char)*c) || *c == '_') {
+                space = true;
+                continue;
+            }
+            if (space && !title.empty()) title += '_';
+            space = false;
+            title += *c;
+        }
+    }
+
+    // The parts of a page with several languages, which are parsed and lowered separately: the content before the
+    // first language, and each language section. Only the section of the default language is lowered right away, the
+    // others when they are first expanded. Every time a part is lowered, the page is stitched together again.
+    // Only the HTML of the parts which aren't lowered yet is kept, and a lowered part only until it's stitched into
+    // `page`.
+    struct Assembly {
+        std::mutex mutex;
+        std::vector<std::string> fragments; // The HTML part `i` is parsed from, freed once it's lowered.
+        std::vector<std::unique_ptr<Page>> parts; // Lowered parts which aren't in `page` yet.
+        std::vector<bool> lowered;
+        // Shown in place of the sections which aren't lowered, decoded and normalized like the lowered headings.
+        std::vector<std::string> headings;
+        std::vector<std::string> anchors;
+        std::shared_ptr<const Page> page; // The most recently stitched page, null until it's first published.
+        std::vector<int> starts; // Part `i` is commands [`starts[i]`, `starts[i + 1]`) of `page`.
+        size_t remaining = 0; // Parts to be lowered before the page is first published.
+        uint64_t version = 0; // Of the body, see `Lookup::versions`.
+    };
+
+    // Builds the next version of the assembly's page: the parts lowered since the last one are put in place of their
+    // headings, and the other parts are copied from the last version. The pool of the last version is copied as a
+    // whole, so the copied commands keep their text. Before the first version, every part which isn't lowered gets a
+    // language heading. Call with the assembly's mutex locked.
+    static std::shared_ptr<Page> stitchPages(Assembly &assembly) {
+        auto page = std::make_shared<Page>();
+        auto previous = assembly.page;
+        size_t link = 0;
+        if (previous != nullptr) {
+            page->pool = previous->pool;
+            page->hasContent = previous->hasContent;
+        }
+        std::vector<int> starts;
+        std::vector<std::pair<int, int>> deferred; // Heading commands of the parts which aren't lowered.
+        for (size_t i = 0; i < assembly.parts.size(); i++) {
+            int offset = (int)page->commands.size();
+            starts.push_back(offset);
+            if (!assembly.lowered[i]) deferred.emplace_back(offset, (int)i);
+            if (auto &part = assembly.parts[i]) {
+                int text = (int)page->pool.size();
+                for (auto &command : part->commands) {
+                    auto &copy = page->commands.emplace_back(command);
+                    copy.text += text;
+                    if (command.kind == DisplayCommand::TableBegin) copy.next += offset;
+                    if (command.kind == DisplayCommand::LanguageHeading) copy.value += text;
+                }
+                page->pool += part->pool;
+                for (auto &link : part->links) {
+                    page->links.push_back({link.command + offset, link.title});
+                }
+                page->hasContent |= part->hasContent;
+            } else if (previous != nullptr) {
+                int begin = assembly.starts[i], end = assembly.starts[i + 1];
+                for (int j = begin; j < end; j++) {
+                    auto &copy = page->commands.emplace_back(previous->commands[j]);
+                    if (copy.kind == DisplayCommand::TableBegin) copy.next += offset - begin;
+                }
+                for (; link < previous->links.size() && previous->links[link].command < end; link++) {
+                    if (previous->links[link].command < begin) continue;
+                    page->links.push_back({previous->links[link].command + offset - begin, previous->links[link].title});
+                }
+            } else {
+                page->AddLanguageHeading(assembly.headings[i], assembly.anchors[i]);
+                page->hasContent = true;
+            }
+        }
+        starts.push_back((int)page->commands.size());
+        for (auto &part : assembly.parts) part = nullptr;
+        assembly.page = page;
+        assembly.starts = std::move(starts);
+        if (!page->hasContent) return page;
+        splitBlocks(*page);
+        for (auto &section : page->sections) {
+            for (auto &[heading, part] : deferred) {
+                if (section.heading == heading) section.deferred = part;
+            }
+        }
+        return page;
+    }
+
+    // State of a lookup of a page, shared by all the tabs showing the page. Background jobs only hold weak references,
+    // so closing the last tab cancels the lookup: the transfer is aborted and queued jobs do nothing.
+    struct Lookup {
+        std::string key; // Of the page in the cache.
+        std::atomic<Priority> priority{Priority::Background};
+        std::atomic<bool> complete{false}; // Set once a complete page is published, after which previews are dropped.
+        // Incremented for every response body to be processed. Pages built from older bodies may be published later,
+        // since the tasks run concurrently, and are dropped.
+        std::atomic<uint64_t> versions{0};
+        // The rest is only accessed by the UI thread.
+        std::shared_ptr<const Page> page; // The most recent version of the page, null until there is one.
+        uint64_t version = 0; // The body `page` was built from.
+        std::shared_ptr<Assembly> assembly; // The parts of `page`, if it was split.
+        std::vector<int> expanded; // Parts of `assembly` which were requested to be lowered.
+    };
+
+    // A version of a page, published by a background job and picked up by the UI thread at the start of a frame.
+    struct Completion {
+        std::weak_ptr<Lookup> lookup;
+        std::shared_ptr<const Page> page;
+        std::shared_ptr<Assembly> assembly;
+        uint64_t version; // See `Lookup::versions`. Previews have version 0.
+        bool expansion; // A section of the page was lowered.
+    };
+
+    CompletionQueue<Completion> completions;
+
+    static PriorityFunction priorityOf(const std::weak_ptr<Lookup> &weak) {
+        return [weak] {
+            auto lookup = weak.lock();
+            return lookup != nullptr ? lookup->priority.load() : Priority::Speculative;
+        };
+    }
+
+    // Returns a new version for a page built from a response body, see `Lookup::versions`.
+    static uint64_t nextVersion(const std::weak_ptr<Lookup> &weak) {
+        auto lookup = weak.lock();
+        return lookup != nullptr ? ++lookup->versions : 0;
+    }
+
+    void publish(const std::weak_ptr<Lookup> &weak, std::shared_ptr<const Page> page, uint64_t version,
+                 std::shared_ptr<Assembly> assembly = nullptr, bool expansion = false) {
+        auto lookup = weak.lock();
+        if (lookup == nullptr) return;
+        if (!page->partial) lookup->complete = true;
+        completions.Push({weak, std::move(page), std::move(assembly), version, expansion});
+    }
+
+    // Hands the pages published since the last frame to their lookups. A page built from an older body than the one
+    // shown is dropped, e.g. the cached copy of a page which was revalidated in the meantime. A preview never replaces
+    // a complete page, and an expanded section is dropped if the page has been replaced since.
+    void receiveCompletions() {
+        completions.Drain([](Completion &&completion) {
+            auto lookup = completion.lookup.lock();
+            if (lookup == nullptr) return;
+            if (completion.version < lookup->version) return;
+            if (completion.page->partial && lookup->page != nullptr && !lookup->page->partial) return;
+            if (completion.expansion && completion.assembly != lookup->assembly) return;
+            if (completion.assembly != lookup->assembly) lookup->expanded.clear();
+            lookup->page = std::move(completion.page);
+            lookup->assembly = std::move(completion.assembly);
+            lookup->version = completion.version;
+        });
+    }
+
+    // Parses and lowers one part of the assembly. The page is published once all the parts which are lowered right
+    // away are done, and again after every part lowered later.
+    void lowerPart(const std::weak_ptr<Lookup> &lookup, const std::shared_ptr<Assembly> &assembly, size_t i) {
+        if (lookup.expired()) return;
+        std::string fragment;
+        {
+            std::lock_guard<std::mutex> lock(assembly->mutex);
+            fragment = std::move(assembly->fragments[i]);
+            assembly->fragments[i] = std::string();
+        }
+        auto part = std::make_unique<Page>();
+        lowerDocument(*parseDocument(std::move(fragment)), *part);
+        std::lock_guard<std::mutex> lock(assembly->mutex);
+        bool expansion = assembly->remaining == 0;
+        assembly->parts[i] = std::move(part);
+        assembly->lowered[i] = true;
+        if (!expansion && --assembly->remaining > 0) return;
+        publish(lookup, stitchPages(*assembly), assembly->version, assembly, expansion);
+    }
+
+    // Splits a page with several languages into parts, and lowers the content before the first language and the
+    // section of `language` concurrently. The other sections are only found by scanning the raw HTML for now.
+    void processSections(const std::weak_ptr<Lookup> &lookup, std::string body, const std::vector<size_t> &headings,
+                         const std::string &language, uint64_t version) {
+        auto assembly = std::make_shared<Assembly>();
+        assembly->version = version;
+        // The skin before the content isn't parsed at all. The content before the first language is parsed with the
+        // start of the document around it. Every section is wrapped in a `.mw-parser-output` of its own. The original
+        // closing tag of `.mw-parser-output` closes the wrapper of the last section, so anything after the content,
+        // like the skin's footer, is left outside of it.
+        size_t content = SectionScanner::ContentStart(body), start = content < headings.front() ? content : 0;
+        assembly->fragments.push_back(body.substr(start, headings.front() - start));
+        for (size_t i = 0; i < headings.size(); i++) {
+            size_t begin = headings[i], end = i + 1 < headings.size() ? headings[i + 1] : body.size();
+            assembly->fragments.push_back("<div class=\"mw-parser-output\">" + body.substr(begin, end - begin) + "</div>");
+        }
+        assembly->headings.emplace_back();
+        assembly->anchors.emplace_back();
+        for (size_t position : headings) {
+            auto anchor = MarkupParser::Decode(SectionScanner::HeadingAnchor(body, position));
+            auto text = MarkupParser::Decode(SectionScanner::HeadingText(body, position));
+            auto &heading = assembly->headings.emplace_back();
+            Page::AppendNormalized(heading, text.empty() ? anchor : text);
+            assembly->anchors.push_back(std::move(anchor));
+        }
+        size_t count = headings.size() + 1;
+        assembly->parts.resize(count);
+        assembly->lowered.resize(count, false);
+        std::vector<size_t> eager;
+        for (size_t i = 0; i < count; i++) {
+            if (i == 0 || assembly->headings[i] == language) eager.push_back(i);
+        }
+        assembly->remaining = eager.size();
+        for (size_t i : eager) {
+            pool.Push([this, lookup, assembly, i] { lowerPart(lookup, assembly, i); }, priorityOf(lookup));
+        }
+    }
+
+    // Lowers a section which was skipped by `processSections`, once it's expanded.
+    void expandSection(const std::shared_ptr<Lookup> &lookup, int part) {
+        if (lookup->assembly == nullptr) return;
+        if (std::find(lookup->expanded.begin(), lookup->expanded.end(), part) != lookup->expanded.end()) return;
+        lookup->expanded.push_back(part);
+        std::weak_ptr<Lookup> weak = lookup;
+        // The user is waiting for it, so it's urgent even if the tab isn't selected anymore.
+        pool.Push([this, weak, assembly = lookup->assembly, part] { lowerPart(weak, assembly, part); });
+    }
+
+    // Builds the page from the response body and publishes it. Parsing and lowering are separate tasks, so that a
+    // lookup closed in between, or one which has become less urgent, doesn't hold up the others.
+    // Pages with language sections are split instead, see `processSections`.
+    void processResponse(const std::weak_ptr<Lookup> &lookup, std::string body, const std::string &language) {
+        uint64_t version = nextVersion(lookup);
+        pool.Push([this, lookup, body = std::move(body), language, version]() mutable {
+            if (lookup.expired()) return;
+            auto headings = findLanguageHeadings(body);
+            if (!headings.empty()) {
+                processSections(lookup, std::move(body), headings, language, version);
+                return;
+            }
+            auto document = parseDocument(std::move(body));
+            pool.Push([this, lookup, document, version] {
+                if (lookup.expired()) return;
+                auto page = std::make_shared<Page>();
+                lowerDocument(*document, *page);
+                if (page->hasContent) splitBlocks(*page);
+                publish(lookup, std::move(page), version);
+            }, priorityOf(lookup));
+        }, priorityOf(lookup));
+    }
+
+    // What to look up. `key` identifies the response in the cache and the lookup registry.
+    struct Request {
+        Source source;
+        std::string server;
+        std::string title;
+        std::string language; // The default language at the time of the request.
+        std::string key;
+    };
+
+    Request makeRequest(const char *query) const {
+        Request request;
+        request.source = source;
+        request.server = server;
+        canonicalTitle(query, request.title);
+        request.language = defaultLanguage;
+        requestKey(query, request.key);
+        if (source == Source::Section && request.language.empty()) {
+            request.source = Source::Render;
+        }
+        return request;
+    }
+
+    // Writes the key of the request for `query` to `key`, without making the whole request. Pages from another server
+    // than the default one, e.g. a local stand-in, get keys of their own, so they aren't mixed up with Wiktionary's.
+    void requestKey(const char *query, std::string &key) const {
+        canonicalTitle(query, key);
+        if (source == Source::Section && defaultLanguage[0] != '\0') {
+            key += '#';
+            key += defaultLanguage;
+        }
+        if (std::string_view(server) != defaultServer) {
+            key += '@';
+            key += server;
+        }
+    }
+
+    static std::string getQueryURL(const Request &request) {
+        auto &base = request.server;
+        switch (request.source) {
+            case Source::Page:
+                return base + "/wiki/" + urlEncode(request.title);
+            case Source::Render:
+                return base + "/w/index.php?action=render&title=" + urlEncode(request.title);
+            case Source::Section:
+                return base + "/w/api.php?action=parse&prop=sections&format=json&formatversion=2&redirects=1&page=" + urlEncode(request.title);
+        }
+        return base;
+    }
+
+    // A body being downloaded. It's compressed for the cache as it arrives, and scanned for the first section to show.
+    struct Download {
+        std::string body;
+        ResponseCache::Compressor compressor;
+        SectionScanner scanner;
+        bool previewed = false;
+    };
+
+    // Builds a page from a single section, to be shown until the whole page is available. It's not shown if there is
+    // already a page, e.g. from the cache. Runs on the task pool.
+    void processPreview(const std::weak_ptr<Lookup> &weak, const std::string &section) {
+        auto lookup = weak.lock();
+        if (lookup == nullptr || lookup->complete) return;
+        auto page = buildPage("<div class=\"mw-parser-output\">" + section + "</div>");
+        if (!page->hasContent) return;
+        page->partial = true;
+        publish(weak, std::move(page), 0);
+    }
+
+    // Called with each chunk of the page. Once the section of the default language is complete, sends it to the task
+    // pool to be shown before the rest arrives. Without a default language there is no preview, since every section
+    // would be shown collapsed.
+    void receiveChunk(const std::weak_ptr<Lookup> &lookup, const Request &request, Download &download, std::string_view chunk) {
+        download.body.append(chunk);
+        download.compressor.Append(chunk);
+        if (download.previewed || request.language.empty()) return;
+        size_t complete = download.scanner.headings.size();
+        download.scanner.Scan(download.body);
+        std::string_view html = download.body;
+        for (size_t i = complete > 0 ? complete - 1 : 0; i + 1 < download.scanner.headings.size(); i++) {
+            size_t begin = download.scanner.headings[i], end = download.scanner.headings[i + 1];
+            auto anchor = SectionScanner::HeadingAnchor(html, begin);
+            if (anchor.empty()) continue;
+            bool match = std::equal(anchor.begin(), anchor.end(), request.language.begin(), request.language.end(),
+                    [](char a, char b) { return a == b || (a == '_' && b == ' '); });
+            if (match) {
+                download.previewed = true;
+                pool.Push([this, lookup, section = std::string(html.substr(begin, end - begin))] { processPreview(lookup, section); }, priorityOf(lookup));
+                return;
+            }
+        }
+    }
+
+    // Handles the response to a request for the page's content. The body is either in `download` or, if it's null,
+    // in the response.
+    void processContent(const std::weak_ptr<Lookup> &lookup, const Request &request, bool cached, cpr::Response &r, Download *download) {
+        if (cached && r.status_code == 304) {
+            cache.Revalidated(request.key);
+        } else if (r.status_code == 200) {
+            std::string body;
+            if (request.source == Source::Section) {
+                body = JSON::Parse(r.text)["parse"]["text"].string;
+                if (body.empty()) {
+                    if (!cached) publish(lookup, std::make_shared<Page>(), nextVersion(lookup));
+                    return;
+                }
+                cache.Store(request.key, body, r.header["ETag"], r.header["Last-Modified"]);
+            } else {
+                download->compressor.Finish();
+                cache.Store(request.key, download->compressor, r.header["ETag"], r.header["Last-Modified"]);
+                body = std::move(download->body);
+            }
+            processResponse(lookup, std::move(body), request.language);
+        } else if (!cached) {
+            publish(lookup, std::make_shared<Page>(), nextVersion(lookup));
+        }
+    }
+
+    // Loads the page from the cache and, if it isn't there or is stale, requests it from Wiktionary. A stale page is
+    // shown until the server responds. Runs on the task pool, so that decompressing the cached page is the first stage
+    // of the lookup.
+    void startLookup(std::weak_ptr<Lookup> lookup, Request request) {
+        if (lookup.expired()) return;
+        ResponseCache::Entry entry;
+        bool cached = cache.Load(request.key, entry);
+        if (cached) {
+            processResponse(lookup, std::move(entry.body), request.language);
+            if (entry.fresh) return;
+        }
+        cpr::Header header;
+        if (!entry.etag.empty()) header["If-None-Match"] = entry.etag;
+        if (!entry.lastModified.empty()) header["If-Modified-Since"] = entry.lastModified;
+        auto cancelled = [lookup] { return lookup.expired(); };
+        if (request.source != Source::Section) {
+            auto download = std::make_shared<Download>();
+            http.Get(getQueryURL(request), std::move(header), [this, lookup, request, cached, download](cpr::Response r) {
+                processContent(lookup, request, cached, r, download.get());
+            }, cancelled, [this, lookup, request, download](std::string_view chunk) {
+                receiveChunk(lookup, request, *download, chunk);
+            }, priorityOf(lookup));
+            return;
+        }
+        // The section's index has to be found first. Only the section's text is validated against the cached copy.
+        http.Get(getQueryURL(request), {}, [this, lookup, request, cached, cancelled, header](cpr::Response r) {
+            if (r.status_code != 200) {
+                if (!cached) publish(lookup, std::make_shared<Page>(), nextVersion(lookup));
+                return;
+            }
+            std::string index;
+            for (auto &section : JSON::Parse(r.text)["parse"]["sections"].array) {
+                if (section["level"].string == "2" && section["line"].string == request.language) {
+                    index = section["index"].string;
+                    break;
+                }
+            }
+            if (index.empty()) {
+                if (!cached) publish(lookup, std::make_shared<Page>(), nextVersion(lookup));
+                return;
+            }
+            std::string url = request.server + "/w/api.php?action=parse&prop=text&format=json&formatversion=2&redirects=1&page="
+                    + urlEncode(request.title) + "&section=" + index;
+            http.Get(url, header, [this, lookup, request, cached](cpr::Response r) {
+                processContent(lookup, request, cached, r, nullptr);
+            }, cancelled, nullptr, priorityOf(lookup));
+        }, cancelled, nullptr, priorityOf(lookup));
+    }
+
+    // Lookups by canonical title. Entries expire when the last tab showing the page is closed.
+    std::unordered_map<std::string, std::weak_ptr<Lookup>> lookups;
+
+    // Returns the lookup of the page, starting it if there is none yet.
+    std::shared_ptr<Lookup> getLookup(const char *query, bool speculative = false) {
+        Request request = makeRequest(query);
+        auto &entry = lookups[request.key];
+        auto lookup = entry.lock();
+        if (lookup == nullptr) {
+            lookup = std::make_shared<Lookup>();
+            lookup->key = request.key;
+            lookup->priority = speculative ? Priority::Speculative : Priority::Background;
+            entry = lookup;
+            std::weak_ptr<Lookup> weak = lookup;
+            pool.Push([this, weak, request = std::move(request)]() mutable {
+                startLookup(std::move(weak), std::move(request));
+            }, priorityOf(weak));
+        } else if (!speculative && lookup->priority == Priority::Speculative) {
+            // The user opened a prefetched page.
+            lookup->priority = Priority::Background;
+            http.Reprioritized();
+            pool.Reprioritized();
+        }
+        return lookup;
+    }
+
+    // The lookup of the selected tab.
+    std::weak_ptr<Lookup> activeLookup;
+
+    void activate(const std::shared_ptr<Lookup> &lookup) {
+        auto previous = activeLookup.lock();
+        if (previous == lookup) return;
+        if (previous != nullptr) previous->priority = Priority::Background;
+        lookup->priority = Priority::Active;
+        activeLookup = lookup;
+        http.Reprioritized();
+        pool.Reprioritized();
+    }
+
+    // Lookups started before the user asked for them, oldest first. They are kept alive, so that opening one of these
+    // pages finds it in the registry. There are at most `maxPrefetched` of them, and at most one is started every
+    // `prefetchInterval` seconds. Their requests and parsing only run when nothing else is waiting.
+    std::deque<std::shared_ptr<Lookup>> prefetched;
+    static constexpr size_t maxPrefetched = 8;
+    static constexpr double prefetchInterval = 1.0;
+    double lastPrefetch = -prefetchInterval;
+    std::string prefetchKey; // Reused, this is checked on every frame while a link is hovered.
+
+    void prefetch(const std::string &title) {
+        if (title.empty() || ImGui::GetTime() - lastPrefetch < prefetchInterval) return;
+        requestKey(title.c_str(), prefetchKey);
+        auto it = lookups.find(prefetchKey);
+        if (it != lookups.end() && !it->second.expired()) return;
+        lastPrefetch = ImGui::GetTime();
+        prefetched.push_back(getLookup(title.c_str(), true));
+        if (prefetched.size() > maxPrefetched) {
+            prefetched.pop_front();
+        }
+    }
+
+    // Prefetches the first entries linked from the block.
+    void prefetchLinks(const Page &page, int block) {
+        auto link = std::lower_bound(page.links.begin(), page.links.end(), page.blocks[block],
+                [](const Page::Link &link, int command) { return link.command < command; });
+        for (int i = 0; i < 2 && link != page.links.end() && link->command < page.blocks[block + 1]; i++, link++) {
+            prefetch(link->title);
+        }
+    }
+
+    // Removes the registry entries of pages which are no longer shown.
+    void collectLookups() {
+        for (auto it = lookups.begin(); it != lookups.end();) {
+            if (it->second.expired()) {
+                it = lookups.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    class Query {
+    private:
+        char query[256] = "";
+        std::shared_ptr<Lookup> lookup;
+        std::shared_ptr<const Page> page;
+        PageLayout layout;
+        int languageGeneration; // The provider's `languageGeneration` when the page was last displayed.
+
+        // Picks up the most recent version of the page. Only the selected tab does this, so tabs in the background
+        // cost nothing when their pages arrive.
+        void poll() {
+            if (lookup->page != page) {
+                page = lookup->page;
+                layout = PageLayout();
+            }
+        }
+
+    public:
+        // Returns false when the tab gets closed.
+        bool DisplayAsTabItem(WiktionaryProvider &provider) {
+            bool open = true;
+            ImGui::PushID(this);
+            if (ImGui::BeginTabItem(query, &open)) {
+                provider.activate(lookup);
+                poll();
+                // TODO: Alternative search results dropdown
+                if (page == nullptr) {
+                    displayLoadingIcon();
+                } else if (page->hasContent) {
+                    bool resolveLanguages = languageGeneration != provider.languageGeneration;
+                    languageGeneration = provider.languageGeneration;
+                    provider.displayPage(lookup, *page, layout, resolveLanguages);
+                    if (page->partial) {
+                        displayLoadingIcon();
+                    }
+                } else {
+                    ImGui::TextUnformatted("Could not retrieve content.");
+                }
+                ImGui::EndTabItem();
+            }
+            ImGui::PopID();
+            return open;
+        }
+
+        Query(WiktionaryProvider &provider, char *text) {
             static_assert(sizeof(input) == sizeof(Query::query));
             memcpy(query, text, sizeof(query));
             text[0] = '\0';
-            char url[512];
-            getQueryURL(url);
-            request = cpr::GetAsync(cpr::Url{url});
+            lookup = provider.getLookup(query);
+            languageGeneration = provider.languageGeneration;
+        }
+    };
+
+    // Title completions for the search field, from the opensearch API. A request is sent once the input hasn't changed
+    // for `debounce` seconds, and results are cached by prefix. A cached list shorter than `limit` contains all the
+    // titles starting with its prefix, so longer inputs are completed from it without any request.
+    class Typeahead {
+        static constexpr int limit = 10;
+        static constexpr double debounce = 0.15;
+
+        struct Result {
+            std::string prefix;
+            std::vector<std::string> titles;
+        };
+
+        // Results arriving from the session pool.
+        struct Inbox {
+            CompletionQueue<Result> results;
+            std::atomic<uint64_t> generation{0}; // Incremented on every edit, which cancels the older requests.
+        };
+
+        std::shared_ptr<Inbox> inbox = std::make_shared<Inbox>();
+        // Completions by prefix. At most `maxCached` are kept, the least recently used one is dropped first.
+        struct Cached {
+            std::vector<std::string> titles;
+            uint64_t used = 0;
+        };
+        static constexpr size_t maxCached = 256;
+        std::unordered_map<std::string, Cached> cache;
+        uint64_t uses = 0;
+        std::string shown; // The input for which `suggestions` are shown.
+        std::vector<std::string> suggestions;
+        bool waiting = false; // True if the input isn't covered by the cache and the request hasn't been sent yet.
+        double editTime = 0;
+        int selected = -1;
+        bool hovered = false;
+
+        static bool startsWith(const std::string &title, const std::string &prefix) {
+            if (title.size() < prefix.size()) return false;
+            for (size_t i = 0; i < prefix.size(); i++) {
+                if (std::tolower((unsigned char)title[i]) != std::tolower((unsigned char)prefix[i])) return false;
+            }
+            return true;
+        }
+
+        // Caches the completions of the prefix, dropping the least recently used ones if there are too many.
+        void store(const std::string &prefix, std::vector<std::string> titles) {
+            if (cache.size() >= maxCached && cache.find(prefix) == cache.end()) {
+                auto oldest = cache.begin();
+                for (auto it = cache.begin(); it != cache.end(); it++) {
+                    if (it->second.used < oldest->second.used) oldest = it;
+                }
+                cache.erase(oldest);
+            }
+            cache[prefix] = {std::move(titles), ++uses};
+        }
+
+        // Shows the suggestions for `text` from the cache. Returns false if they have to be requested.
+        bool complete(const std::string &text) {
+            selected = -1;
+            shown = text;
+            auto exact = cache.find(text);
+            if (exact != cache.end()) {
+                exact->second.used = ++uses;
+                suggestions = exact->second.titles;
+                return true;
+            }
+            for (size_t length = text.size() - 1; length > 0; length--) {
+                auto it = cache.find(text.substr(0, length));
+                if (it == cache.end()) continue;
+                it->second.used = ++uses;
+                suggestions.clear();
+                for (auto &title : it->second.titles) {
+                    if (startsWith(title, text)) suggestions.push_back(title);
+                }
+                if ((int)it->second.titles.size() < limit) {
+                    store(text, suggestions);
+                    return true;
+                }
+                // The filtered list is shown until the complete one arrives.
+                return false;
+            }
+            suggestions.clear();
+            return false;
+        }
+
+        void request(WiktionaryProvider &provider, const std::string &text) {
+            uint64_t generation = inbox->generation;
+            std::string url = std::string(provider.server) + "/w/api.php?action=opensearch&format=json&formatversion=2&namespace=0&limit="
+                    + std::to_string(limit) + "&search=" + urlEncode(text);
+            provider.http.Get(std::move(url), {}, [inbox = inbox, text](cpr::Response r) {
+                if (r.status_code != 200) return;
+                Result result{text, {}};
+                for (auto &title : JSON::Parse(r.text)[1].array) {
+                    result.titles.push_back(title.string);
+                }
+                inbox->results.Push(std::move(result));
+            }, [inbox = inbox, generation] { return inbox->generation != generation; });
+        }
+
+    public:
+        // Call right after the search field. `input` may be replaced by a suggestion chosen with the keyboard.
+        void Update(WiktionaryProvider &provider, char *input, bool edited, bool active) {
+            inbox->results.Drain([this](Result &&result) {
+                if (result.prefix == shown) {
+                    suggestions = result.titles;
+                    selected = -1;
+                }
+                store(result.prefix, std::move(result.titles));
+            });
+            if (edited) {
+                inbox->generation++;
+                waiting = input[0] != '\0' && !complete(input);
+                editTime = ImGui::GetTime();
+            }
+            if (waiting && ImGui::GetTime() - editTime >= debounce) {
+                waiting = false;
+                request(provider, input);
+            }
+            // The most likely choice is prefetched once the user pauses typing.
+            if (!suggestions.empty() && shown == input && ImGui::GetTime() - editTime >= debounce) {
+                provider.prefetch(suggestions[std::max(selected, 0)]);
+            }
+            if (active && !suggestions.empty()) {
+                if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) selected = std::min(selected + 1, (int)suggestions.size() - 1);
+                if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) selected = std::max(selected - 1, -1);
+                if (ImGui::IsKeyPressed(ImGuiKey_Escape)) suggestions.clear();
+            }
+        }
+
+        // Call when the search is submitted from the search field.
+        void Submit(char *input) {
+            if (selected >= 0 && selected < (int)suggestions.size()) {
+                snprintf(input, 256, "%s", suggestions[selected].c_str());
+            }
+            inbox->generation++;
+            waiting = false;
+            suggestions.clear();
+        }
+
+        // Displays the dropdown under the previous item while it's active or the dropdown is hovered. Returns true if
+        // a suggestion was clicked, in which case it's copied to `input`.
+        bool Display(char *input, bool active, ImVec2 position, float width) {
+            if (suggestions.empty() || shown != input || (!active && !hovered)) {
+                hovered = false;
+                return false;
+            }
+            bool chosen = false;
+            ImGui::SetNextWindowPos(position);
+            ImGui::SetNextWindowSize(ImVec2(width, 0.0f));
+            ImGui::Begin("##Suggestions", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize
+                    | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav
+                    | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDocking);
+            ImGui::BringWindowToDisplayFront(ImGui::GetCurrentWindow());
+            for (int i = 0; i < (int)suggestions.size(); i++) {
+                if (ImGui::Selectable(suggestions[i].c_str(), i == selected)) {
+                    snprintf(input, 256, "%s", suggestions[i].c_str());
+                    chosen = true;
+                }
+            }
+            hovered = ImGui::IsWindowHovered();
+            ImGui::End();
+            if (chosen) {
+                selected = -1;
+                Submit(input);
+            }
+            return chosen;
         }
     };
 
     char defaultLanguage[256] = "";
+    int defaultLanguageId = Languages::Intern(defaultLanguage);
+    int languageGeneration = 0; // Incremented when the default language is changed, see `Query::languageGeneration`.
+    int cacheSize = 64; // In MiB.
+    int concurrentRequests = 4;
+    Source source = Source::Render;
+    static constexpr std::string_view defaultServer = "https://en.wiktionary.org";
+    char server[256] = "https://en.wiktionary.org"; // `defaultServer` at first.
 
     void displaySettings() {
         ImGui::InputTextWithHint("Default language", "English", defaultLanguage, 256, ImGuiInputTextFlags_AutoSelectAll);
+        // Only once the name is complete, so that the open pages aren't laid out again and the partial names aren't
+        // interned on every keystroke.
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            defaultLanguageId = Languages::Intern(defaultLanguage);
+            languageGeneration++;
+        }
+        ImGui::Combo("Source", (int *)&source, "Whole page\0Page content\0Default language only\0");
+        ImGui::InputText("Server", server, 256, ImGuiInputTextFlags_AutoSelectAll);
+        if (ImGui::InputInt("Cache size (MiB)", &cacheSize, 16, 64, ImGuiInputTextFlags_EnterReturnsTrue)) {
+            cacheSize = std::max(cacheSize, 0);
+            cache.SetBudget((uint64_t)cacheSize << 20);
+        }
+        if (ImGui::SliderInt("Concurrent requests", &concurrentRequests, 1, SessionPool::maxLimit)) {
+            http.SetLimit(concurrentRequests);
+        }
     }
 
+    // Timings of finding the content and the language headings of a page: by scanning the raw HTML, by parsing it with
+    // `MarkupParser`, and by parsing it with Gumbo.
+    struct Benchmark {
+        std::atomic<bool> running{false};
+        std::atomic<size_t> bytes{0};
+        std::atomic<size_t> scannerHeadings{0}, parserHeadings{0}, gumboHeadings{0};
+        std::atomic<double> scanner{0}, parser{0}, gumbo{0}; // The best of several runs, in seconds.
+    } benchmark;
+
     char input[256] = "";
     std::list<Query> queries;
+    Typeahead typeahead;
+    ResponseCache cache;
+    TaskPool pool;
+    SessionPool http;
+
+    // The page is read back from the cache, since the body isn't kept once it's lowered.
+    void runBenchmark(std::string key) {
+        benchmark.running = true;
+        pool.Push([this, key] {
+            ResponseCache::Entry entry;
+            if (!cache.Load(key, entry)) {
+                benchmark.bytes = 0;
+                benchmark.running = false;
+                return;
+            }
+            const std::string &html = entry.body;
+            auto best = [](int runs, const std::function<void()> &run) {
+                double best = INFINITY;
+                for (int i = 0; i < runs; i++) {
+                    auto start = std::chrono::steady_clock::now();
+                    run();
+                    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                }
+                return best;
+            };
+            auto countHeadings = [](const Markup &markup) {
+                size_t headings = 0;
+                if (markup.Empty()) return headings;
+                markupForEachChild(markup, 0) {
+                    headings += markup.IsElement(child, GUMBO_TAG_H2) && !getHeaderText(markup, child).empty();
+                }
+                return headings;
+            };
+            size_t scanned = 0, parsed = 0, gumbo = 0;
+            benchmark.scanner = best(20, [&] {
+                scanned = SectionScanner::ContentStart(html) != std::string_view::npos ? findLanguageHeadings(html).size() : 0;
+            });
+            benchmark.parser = best(5, [&] {
+                Markup markup;
+                parsed = MarkupParser::Parse(html, markup) ? countHeadings(markup) : 0;
+            });
+            benchmark.gumbo = best(3, [&] {
+                Markup markup;
+                HTML document(html.data(), html.size());
+                if (auto content = findContent(document.output->root)) {
+                    convertGumbo(content, markup, -1, -1);
+                }
+                gumbo = countHeadings(markup);
+            });
+            benchmark.scannerHeadings = scanned;
+            benchmark.parserHeadings = parsed;
+            benchmark.gumboHeadings = gumbo;
+            benchmark.bytes = html.size();
+            benchmark.running = false;
+        });
+    }
+
+    void displayStatistics() {
+        ImGui::Text("Worker threads: %zu", pool.Threads());
+        ImGui::Text("Requests: %llu", (unsigned long long)http.Completed());
+        ImGui::Text("Reused connections: %llu", (unsigned long long)http.Reused());
+        ImGui::Text("Cancelled requests: %llu", (unsigned long long)http.Cancelled());
+        ImGui::Text("Parsed documents: %llu, with Gumbo: %llu", (unsigned long long)(fastParses + gumboParses), (unsigned long long)gumboParses);
+        ImGui::Separator();
+        ImGui::Text("HTML scanner: %s", ByteScanner::Implementation());
+        auto lookup = activeLookup.lock();
+        bool available = !benchmark.running && lookup != nullptr && lookup->assembly != nullptr;
+        ImGui::BeginDisabled(!available);
+        if (ImGui::Button("Compare with Gumbo on this page")) {
+            runBenchmark(lookup->key);
+        }
+        ImGui::EndDisabled();
+        if (benchmark.running) {
+            displayLoadingIcon();
+        } else if (benchmark.bytes > 0) {
+            double megabytes = (double)benchmark.bytes / (1 << 20);
+            ImGui::Text("Scanner: %.3f ms (%.0f MiB/s), %zu headings", benchmark.scanner * 1000, megabytes / benchmark.scanner, benchmark.scannerHeadings.load());
+            ImGui::Text("Parser: %.3f ms (%.0f MiB/s), %zu headings", benchmark.parser * 1000, megabytes / benchmark.parser, benchmark.parserHeadings.load());
+            ImGui::Text("Gumbo: %.3f ms (%.0f MiB/s), %zu headings", benchmark.gumbo * 1000, megabytes / benchmark.gumbo, benchmark.gumboHeadings.load());
+        }
+    }
 
 public:
+    // Members are destroyed in reverse order, so the lookups would outlive the pools. Closing the tabs and dropping the
+    // prefetched pages first cancels the transfers, and the task pool is stopped before the session pool, so that no
+    // task makes a request once the session pool is gone.
+    ~WiktionaryProvider() {
+        queries.clear();
+        prefetched.clear();
+        pool.Stop();
+        http.Stop();
+    }
+
     void Display() {
+        receiveCompletions();
         ImGui::SetNextWindowSize(ImVec2(300, 600), ImGuiCond_Appearing);
         if (ImGui::Begin("Wiktionary", nullptr, ImGuiWindowFlags_MenuBar)) {
             // Search field
             ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - 70);
             bool search = ImGui::InputTextWithHint("##Word", "Search Wiktionary", input, 256,
                                 ImGuiInputTextFlags_AutoSelectAll|ImGuiInputTextFlags_EnterReturnsTrue);
+            bool active = ImGui::IsItemActive();
+            ImVec2 dropdownPosition(ImGui::GetItemRectMin().x, ImGui::GetItemRectMax().y);
+            float dropdownWidth = ImGui::GetItemRectSize().x;
+            typeahead.Update(*this, input, ImGui::IsItemEdited(), active);
             ImGui::SameLine();
             search |= ImGui::Button("Look up");
+            if (search) {
+                typeahead.Submit(input);
+            }
+            search |= typeahead.Display(input, active, dropdownPosition, dropdownWidth);
             if (search && input[0] != '\0') {
-                queries.emplace_back(input);
+                collectLookups();
+                queries.emplace_back(*this, input);
             }
             if (ImGui::BeginMenuBar()) {
                 if (ImGui::BeginMenu("Settings")) {
                     displaySettings();
                     ImGui::EndMenu();
                 }
+                if (ImGui::BeginMenu("Statistics")) {
+                    displayStatistics();
+                    ImGui::EndMenu();
+                }
                 ImGui::EndMenuBar();
             }
             // Results